@@ -0,0 +1,176 @@
+// Compares the lyso_wfs TTree and the lyso_wfs RNTuple (Output sink = rntuple)
+// on the same input: write and read throughput, and file size.
+//
+// The events of a Bartender output file written with the "file" sink are
+// rewritten both as TTree and as RNTuple with the same compression, then
+// read back. The events are kept in memory, so only the first 200 are used
+// unless more are asked for (-1 for all), e.g.
+//
+//   root -l -b -q 'compareRNTuple.cc("BarID_1707049321.root", 500)'
+//
+// Both writers take the events by address, as the lyso_wfs sinks do.
+//
+// Needs ROOT 6.32 or later.
+#include <iostream>
+#include <vector>
+
+#include <RVersion.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TStopwatch.h>
+#include <TSystem.h>
+#include <ROOT/RField.hxx>
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleReader.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+
+using namespace std;
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,36,0)
+namespace RNTupleAPI = ROOT;
+#else
+namespace RNTupleAPI = ROOT::Experimental;
+#endif
+
+
+// Prints one row of the comparison
+void PrintRow(const char *format, Double_t writeTime, Double_t readTime, Long64_t nBytes, Long64_t nEvents)
+{
+    Double_t mb = nBytes / 1.e6;
+    cout << format << ": " << mb << " MB, write " << nEvents / writeTime << " events/s, read "
+         << nEvents / readTime << " events/s (" << mb / readTime << " MB/s on disk)" << endl;
+}
+
+
+void compareRNTuple(const char *filename, Long64_t maxEvents = 200)
+{
+    // Input events, all in memory so that only the writing is timed
+    unique_ptr<TFile> inFile(TFile::Open(filename, "READ"));
+    if(!inFile || inFile->IsZombie())
+    {
+        cerr << "Can't open " << filename << endl;
+        return;
+    }
+    TTree *inTree = inFile->Get<TTree>("lyso_wfs");
+    if(!inTree)
+    {
+        cerr << "No lyso_wfs tree in " << filename << endl;
+        return;
+    }
+
+    Int_t event;
+    vector<vector<Float_t>> *front = nullptr, *back = nullptr;
+    inTree->SetBranchAddress("Event", &event);
+    inTree->SetBranchAddress("Front", &front);
+    inTree->SetBranchAddress("Back", &back);
+
+    Long64_t nEvents = inTree->GetEntries();
+    if(maxEvents > 0 && maxEvents < nEvents)
+        nEvents = maxEvents;
+    if(nEvents == 0)
+    {
+        cerr << "No events in " << filename << endl;
+        return;
+    }
+
+    vector<Int_t> events(nEvents);
+    vector<vector<vector<Float_t>>> fronts(nEvents), backs(nEvents);
+    for(Long64_t i = 0; i < nEvents; i++)
+    {
+        inTree->GetEntry(i);
+        events[i] = event;
+        fronts[i] = *front;
+        backs[i] = *back;
+    }
+    Int_t compression = inFile->GetCompressionSettings();
+    inFile->Close();
+
+    TStopwatch watch;
+    Double_t writeTime[2], readTime[2];
+    const char *outFilenames[2] = {"compare_ttree.root", "compare_rntuple.root"};
+
+    // Write the TTree
+    watch.Start();
+    {
+        unique_ptr<TFile> outFile(TFile::Open(outFilenames[0], "RECREATE", "", compression));
+        TTree tree("lyso_wfs", "lyso_wfs");
+        vector<vector<Float_t>> *treeFront = &fronts[0], *treeBack = &backs[0];
+        tree.Branch("Event", &event);
+        tree.Branch("Front", &treeFront);
+        tree.Branch("Back", &treeBack);
+        for(Long64_t i = 0; i < nEvents; i++)
+        {
+            event = events[i];
+            treeFront = &fronts[i];
+            treeBack = &backs[i];
+            tree.Fill();
+        }
+        tree.Write();
+        outFile->Close();
+    }
+    writeTime[0] = watch.RealTime();
+
+    // Write the RNTuple
+    watch.Start();
+    {
+        auto model = RNTupleAPI::RNTupleModel::CreateBare();
+        model->AddField(make_unique<RNTupleAPI::RField<Int_t>>("Event"));
+        model->AddField(make_unique<RNTupleAPI::RField<vector<vector<Float_t>>>>("Front"));
+        model->AddField(make_unique<RNTupleAPI::RField<vector<vector<Float_t>>>>("Back"));
+        RNTupleAPI::RNTupleWriteOptions options;
+        options.SetCompression(compression);
+        auto writer = RNTupleAPI::RNTupleWriter::Recreate(move(model), "lyso_wfs", outFilenames[1], options);
+        auto entry = writer->GetModel().CreateBareEntry();
+        for(Long64_t i = 0; i < nEvents; i++)
+        {
+            entry->BindRawPtr("Event", &events[i]);
+            entry->BindRawPtr("Front", &fronts[i]);
+            entry->BindRawPtr("Back", &backs[i]);
+            writer->Fill(*entry);
+        }
+    }
+    writeTime[1] = watch.RealTime();
+
+    // Read the TTree, touching every sample
+    Double_t sum[2] = {0, 0};
+    watch.Start();
+    {
+        unique_ptr<TFile> file(TFile::Open(outFilenames[0], "READ"));
+        TTree *tree = file->Get<TTree>("lyso_wfs");
+        vector<vector<Float_t>> *treeFront = nullptr, *treeBack = nullptr;
+        tree->SetBranchAddress("Front", &treeFront);
+        tree->SetBranchAddress("Back", &treeBack);
+        for(Long64_t i = 0; i < tree->GetEntries(); i++)
+        {
+            tree->GetEntry(i);
+            for(const auto &wave : *treeFront) for(Float_t v : wave) sum[0] += v;
+            for(const auto &wave : *treeBack) for(Float_t v : wave) sum[0] += v;
+        }
+    }
+    readTime[0] = watch.RealTime();
+
+    // Read the RNTuple
+    watch.Start();
+    {
+        auto reader = RNTupleAPI::RNTupleReader::Open("lyso_wfs", outFilenames[1]);
+        auto viewFront = reader->GetView<vector<vector<Float_t>>>("Front");
+        auto viewBack = reader->GetView<vector<vector<Float_t>>>("Back");
+        for(auto i : reader->GetEntryRange())
+        {
+            for(const auto &wave : viewFront(i)) for(Float_t v : wave) sum[1] += v;
+            for(const auto &wave : viewBack(i)) for(Float_t v : wave) sum[1] += v;
+        }
+    }
+    readTime[1] = watch.RealTime();
+
+    if(sum[0] != sum[1])
+        cerr << "The two formats don't hold the same samples!" << endl;
+
+    cout << nEvents << " events of " << filename << ", compression " << compression << endl;
+    for(Int_t f = 0; f < 2; f++)
+    {
+        FileStat_t stat;
+        gSystem->GetPathInfo(outFilenames[f], stat);
+        PrintRow(f == 0 ? "TTree  " : "RNTuple", writeTime[f], readTime[f], stat.fSize, nEvents);
+    }
+}
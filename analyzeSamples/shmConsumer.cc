@@ -0,0 +1,47 @@
+// Example of an analysis process reading the waveforms published by bartender
+// with "Output sink = shm". Build it against the bartendershm library:
+//
+//   g++ -std=c++17 -I/path/to/Bartender_LYSO/include shmConsumer.cc -L/path/to/build -lbartendershm -lrt -o shmConsumer
+//   ./shmConsumer /BarID_1707049321
+#include <iostream>
+
+#include "shmring.hh"
+
+using namespace std;
+
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " shmName" << endl;
+        return 1;
+    }
+
+    ShmConsumer consumer;
+    if(!consumer.Open(argv[1], 60000))
+    {
+        cerr << "Can't attach to " << argv[1] << endl;
+        return 1;
+    }
+
+    // Minimum sample of each event, read in place
+    ShmEventView view;
+    long nEvents = 0;
+    while(consumer.Acquire(view, 60000))
+    {
+        float minimum = view.fFront[0];
+        for(unsigned i = 0; i < view.fChannels * view.fSamplings; i++)
+        {
+            if(view.fFront[i] < minimum) minimum = view.fFront[i];
+            if(view.fBack[i] < minimum) minimum = view.fBack[i];
+        }
+        cout << "Event " << view.fEvent << ": minimum " << minimum << " V" << endl;
+
+        consumer.Release();
+        nEvents++;
+    }
+
+    cout << "Consumed " << nEvents << " events" << endl;
+    return 0;
+}
@@ -10,18 +10,26 @@
  * @brief Definition of the main function of Bartender_LYSO.
  */
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <chrono>
 #include <cstring>
+#include <memory>
+#include <thread>
  
 #include <TFile.h>
 #include <TTree.h>
+#include <TROOT.h>
  
 #include "globals.hh"
 #include "configure.hh"
 #include "bar.hh"
 #include "SiPM.hh"
 #include "summary.hh"
+#include "trace.hh"
+#include "eventloop.hh"
+#include "serve.hh"
+#include "autotune.hh"
 
  
 using namespace std;
@@ -42,12 +50,39 @@ using namespace std;
  */
 int main(int argc, char** argv)
 {
+    // Daemon mode: ./bartender_lyso --serve <spool dir> <mac> [workers]
+    if(argc >= 4 && std::strcmp(argv[1], "--serve") == 0)
+    {
+        Int_t nWorkers = std::thread::hardware_concurrency();
+        if(argc >= 5)
+        {
+            try {
+                nWorkers = std::stoi(argv[4]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: the number of workers " << argv[4] << " is not a valid number\n";
+                return 1;
+            }
+        }
+        return Bartender_Serve(argv[3], argv[2], std::max(nWorkers, 1));
+    }
+
     // Get input files
     const char *mcFilename = argv[1];
     const char *sipmFilename = argv[2];
     Int_t threadID = -1;
     bool isMultithreading = false;
     Int_t maxEvents = -1;
+    bool isResume = false;
+    bool isApproxReport = false;
+    bool isReplay = false;
+    bool isImplicitMT = false;
+    string sink;
+    string traceFilename;
+    string overlayFilename;
+    vector<const char*> sweepFilenames;
+    vector<pair<string, string>> filterOptions;
+    Long64_t autotuneEvents = 0;
+    Long64_t autotuneMemory = 0;
 
     // Control for multithreading and max events
     for (int i = 3; i < argc; ++i) {
@@ -63,6 +98,73 @@ int main(int argc, char** argv)
             std::cerr << "Errore: specificare il numero di eventi dopo -t o -T\n";
             return 1;
         }
+    } else if (std::strcmp(argv[i], "--resume") == 0) {
+        isResume = true;
+    } else if (std::strcmp(argv[i], "--approx-report") == 0) {
+        isApproxReport = true;
+    } else if (std::strcmp(argv[i], "--replay") == 0) {
+        isReplay = true;
+    } else if (std::strcmp(argv[i], "--implicit-mt") == 0) {
+        isImplicitMT = true;
+    } else if (std::strcmp(argv[i], "--sink") == 0) {
+        if (i + 1 < argc) {
+            sink = argv[++i];
+        } else {
+            std::cerr << "Error: specify file, rntuple, binary or shm after --sink\n";
+            return 1;
+        }
+    } else if (std::strcmp(argv[i], "--trace") == 0) {
+        if (i + 1 < argc) {
+            traceFilename = argv[++i];
+        } else {
+            std::cerr << "Error: specify the JSON file after --trace\n";
+            return 1;
+        }
+    } else if (std::strcmp(argv[i], "--build-overlay") == 0) {
+        if (i + 1 < argc) {
+            overlayFilename = argv[++i];
+        } else {
+            std::cerr << "Error: specify the library file after --build-overlay\n";
+            return 1;
+        }
+    } else if (std::strcmp(argv[i], "--channels-F") == 0 || std::strcmp(argv[i], "--channels-B") == 0) {
+        if (i + 1 < argc) {
+            filterOptions.emplace_back(argv[i], argv[i+1]);
+            ++i;
+        } else {
+            std::cerr << "Error: specify the list of channels (e.g. \"0-8,20\") after " << argv[i] << "\n";
+            return 1;
+        }
+    } else if (std::strcmp(argv[i], "--hits-F") == 0 || std::strcmp(argv[i], "--hits-B") == 0) {
+        if (i + 2 < argc) {
+            filterOptions.emplace_back(argv[i], std::string(argv[i+1]) + " " + argv[i+2]);
+            i += 2;
+        } else {
+            std::cerr << "Error: specify the minimum and maximum hits (< 0 for no limit) after " << argv[i] << "\n";
+            return 1;
+        }
+    } else if (std::strcmp(argv[i], "--autotune") == 0) {
+        if (i + 2 < argc) {
+            try {
+                autotuneEvents = std::stoll(argv[i+1]);
+                autotuneMemory = static_cast<Long64_t>(std::stod(argv[i+2]) * 1e6);
+            } catch (const std::invalid_argument& e) {
+                std::cerr << "Error: --autotune needs the events of the sample and the memory budget in MB\n";
+                return 1;
+            }
+            i += 2;
+        } else {
+            std::cerr << "Error: specify the events of the sample and the memory budget in MB (0 for no limit) after --autotune\n";
+            return 1;
+        }
+    } else if (std::strcmp(argv[i], "--sweep") == 0) {
+        // All the following .mac files are DAQ configurations of the sweep
+        while (i + 1 < argc && std::string(argv[i+1]).size() > 4 && std::string(argv[i+1]).substr(std::string(argv[i+1]).size() - 4) == ".mac")
+            sweepFilenames.push_back(argv[++i]);
+        if (sweepFilenames.empty()) {
+            std::cerr << "Error: specify the .mac files of the sweep after --sweep\n";
+            return 1;
+        }
     } else if (threadID == -1) {
         try {
             threadID = std::stoi(argv[i]);
@@ -80,40 +182,175 @@ int main(int argc, char** argv)
     else
         cout << "BarWT" << threadID << ">> Start" << endl; 
 
+    if(!traceFilename.empty())
+        Trace::Start(traceFilename, threadID);
+
+    // The pages of the rntuple sink are then compressed in parallel: it takes
+    // all the cores, so it's left to the user of a single-process run
+    if(isImplicitMT)
+        ROOT::EnableImplicitMT();
+
     // Instances and configuration of SiPM and BarLYSO
     SiPM *sipm = new SiPM();
     BarLYSO *bar = new BarLYSO(mcFilename, threadID);
     Bartender_Configure(sipmFilename, bar, sipm);
+    if(!sink.empty())
+        bar->GetOutput()->fSink = sink;
+    Bartender_ApplyFilterOptions(filterOptions, bar);
 
-    // Set parameters and load TTree
-    bar->SetParsDistro();
-    unique_ptr<TFile> mcFile(TFile::Open(mcFilename, "READ"));
-    TTree *lyso = mcFile->Get<TTree>("lyso");
-    
-    lyso->SetBranchStatus("*", false);
-    lyso->SetBranchStatus("Event", true);
-    lyso->SetBranchStatus("NHits_F", true);
-    lyso->SetBranchStatus("NHits_B", true);    
-    lyso->SetBranchStatus("T_F", true);
-    lyso->SetBranchStatus("Ch_F", true);
-    lyso->SetBranchStatus("T_B", true);
-    lyso->SetBranchStatus("Ch_B", true);
-
-    Int_t fEvent;
-    Int_t fNHits_F, fNHits_B;
-    vector<Double_t> *fT_F = 0, *fT_B = 0;
-    vector<Int_t> *fCh_F = 0, *fCh_B = 0;
-
-    lyso->SetBranchAddress("Event", &fEvent);
-    lyso->SetBranchAddress("NHits_F", &fNHits_F);
-    lyso->SetBranchAddress("NHits_B", &fNHits_B);
-    lyso->SetBranchAddress("Ch_F", &fCh_F);
-    lyso->SetBranchAddress("Ch_B", &fCh_B);
-    lyso->SetBranchAddress("T_F", &fT_F);
-    lyso->SetBranchAddress("T_B", &fT_B);
+    // Only compare exact and approximated synthesis, without output
+    if(isApproxReport)
+    {
+        bar->SetParsDistro();
+        bar->SetSamplingTimes();
+        bar->ValidateApprox("Approx_report.txt");
+        delete sipm;
+        delete bar;
+        return 0;
+    }
+
+    // Free-running mode: one timeline, saved window by window
+    if(bar->IsFreeRunning() && (!sweepFilenames.empty() || isResume))
+    {
+        cerr << "Error: the free-running mode supports neither --sweep nor --resume" << endl;
+        delete sipm;
+        delete bar;
+        return 1;
+    }
+
+    // Replay: the input is the output of a run with Save photons = true, and
+    // the new output is named after both the input and the mac
+    if(isReplay)
+    {
+        if(!sweepFilenames.empty() || !overlayFilename.empty() || bar->IsFreeRunning())
+        {
+            cerr << "Error: --replay supports neither --sweep, --build-overlay nor the free-running mode" << endl;
+            delete sipm;
+            delete bar;
+            return 1;
+        }
+        string input = mcFilename;
+        string mac = sipmFilename;
+        mac = mac.substr(mac.find_last_of('/') + 1);
+        mac = mac.substr(0, mac.find_last_of('.'));
+        bar->SetOutputFilename(input.substr(0, input.find_last_of('.')) + "_" + mac + ".root");
+    }
+
+    // Autotune: the output settings are chosen by writing a sample of the MC
+    // entries with a few candidates
+    string autotuneReport;
+    if(autotuneEvents > 0)
+    {
+        if(isResume || isReplay || !overlayFilename.empty() || bar->IsFreeRunning())
+        {
+            cerr << "Error: --autotune supports neither --resume, --replay, --build-overlay nor the free-running mode" << endl;
+            delete sipm;
+            delete bar;
+            return 1;
+        }
+        Bartender_Autotune(bar, mcFilename, sipmFilename, threadID, autotuneEvents, autotuneMemory, autotuneReport);
+
+        // The workers of bartenderMT leave the report to its merged summary
+        if(isMultithreading && !autotuneReport.empty())
+        {
+            ofstream reportFile("Autotune_" + to_string(bar->GetID()) + "_t" + to_string(threadID) + ".txt");
+            reportFile << autotuneReport;
+        }
+    }
+
+    // Background library: the noiseless waveforms go to the library instead
+    // of the output
+    unique_ptr<OverlayWriter> overlay;
+    if(!overlayFilename.empty())
+    {
+        if(!sweepFilenames.empty() || isResume || bar->IsFreeRunning())
+        {
+            cerr << "Error: --build-overlay supports neither --sweep, --resume nor the free-running mode" << endl;
+            delete sipm;
+            delete bar;
+            return 1;
+        }
+
+        // The dark counts belong to the signal run, which adds its own
+        SiPMNoise noise = bar->GetSiPMNoise();
+        if(noise.fDarkRate > 0)
+        {
+            cout << "No dark counts in the background library" << endl;
+            noise.fDarkRate = 0;
+            bar->SetSiPMNoise(noise);
+        }
+
+        overlay = make_unique<OverlayWriter>();
+        if(!overlay->Open(overlayFilename, bar->GetChannels(), bar->GetSamplings(), bar->GetDAQ()->fSamplingSpeed))
+        {
+            delete sipm;
+            delete bar;
+            return 1;
+        }
+    }
+    else if(!bar->OpenOutput(isResume))
+    {
+        delete sipm;
+        delete bar;
+        return 1;
+    }
+
+    // Sweep mode: one generator per additional DAQ configuration, fed with
+    // the waveforms (or the photons) of the main one
+    vector<SweepTarget> sweepTargets;
+    for(size_t i = 0; i < sweepFilenames.size(); i++)
+    {
+        SiPM sweepSipm;
+        BarLYSO *sweepBar = new BarLYSO(mcFilename, threadID);
+        Bartender_Configure(sweepFilenames[i], sweepBar, &sweepSipm);
+        if(!sink.empty())
+            sweepBar->GetOutput()->fSink = sink;
+        Bartender_ApplyFilterOptions(filterOptions, sweepBar);
+
+        string outputFilename = sweepBar->GetOutputFilename();
+        sweepBar->SetOutputFilename(outputFilename.substr(0, outputFilename.size() - 5) + "_sw" + to_string(i) + ".root");
+        if(!sweepBar->OpenOutput(isResume))
+        {
+            delete sweepBar;
+            for(const SweepTarget &sweep : sweepTargets)
+                delete sweep.fBar;
+            bar->CloseOutput();
+            delete sipm;
+            delete bar;
+            return 1;
+        }
+
+        // Another pulse model samples its own parameters, and so does a resumed
+        // configuration behind the main generator
+        if(sweepBar->GetPulseModel() != bar->GetPulseModel() || isResume)
+            sweepBar->SetParsDistro();
+
+        // Only the channels of the main generator are synthesized and recorded
+        const EventFilter &sweepFilter = sweepBar->GetFilter();
+        Bool_t isSameChannels = sweepFilter.fChannels_F == bar->GetFilter().fChannels_F && sweepFilter.fChannels_B == bar->GetFilter().fChannels_B;
+        Bool_t isSameSiPM = sweepBar->GetSiPMNoise() == bar->GetSiPMNoise();
+        sweepTargets.push_back({sweepBar, sweepBar->HasSameSampling(*bar) && sweepBar->GetPulseModel() == bar->GetPulseModel() && isSameChannels && isSameSiPM});
+    }
+    if(!sweepTargets.empty())
+        bar->SetRecordPhotons(true);
+
+    // Set parameters and load TTree (a replay samples the parameters only
+    // with another pulse model)
+    McInput mc;
+    PhotonCache cache;
+    if(!isReplay)
+        bar->SetParsDistro();
+    if(isReplay ? !cache.Open(mcFilename) : !mc.Open(mcFilename))
+    {
+        delete sipm;
+        delete bar;
+        return 1;
+    }
+    if(isReplay && cache.GetPulseModel() != bar->GetPulseModel())
+        bar->SetParsDistro();
 
     // Number of events and initialize containers
-    Int_t nEntries = lyso->GetEntries();
+    Long64_t nEntries = isReplay ? cache.GetEntries() : mc.GetEntries();
     if(maxEvents > 0 && maxEvents < nEntries)
         nEntries = maxEvents;
     bar->SetEvents(nEntries);
@@ -126,52 +363,65 @@ int main(int argc, char** argv)
     // Start with the Bartender
     auto start_chrono = chrono::high_resolution_clock::now();
 
-    // Sampling times
-    bar->SetSamplingTimes();
-
-    // Event loop
-    for(Int_t k = 0; k < nEntries; k++)
+    // Sampling times (a resumed run keeps those of the checkpoint)
+    if(bar->IsFreeRunning())
+        bar->BeginFreeRunning();
+    if(bar->GetResumeEntry() == 0)
+        bar->SetSamplingTimes();
+    Long64_t firstEntry = bar->GetResumeEntry();
+    for(SweepTarget &sweep : sweepTargets)
     {
-        lyso->GetEntry(k);
-
-        bar->InitializeBaselines(fEvent);
-
-        for(Int_t j = 0; j < fNHits_F; j++)
-            bar->SetFrontWaveform(fCh_F->data()[j], fT_F->data()[j]);
-
-        for(Int_t j = 0; j < fNHits_B; j++)
-            bar->SetBackWaveform(fCh_B->data()[j], fT_B->data()[j]);
-
-        bar->SaveEvent();
-        bar->ClearContainers();
-
-        if(nEntries < 10 || k % (nEntries / 10) == 0)
+        if(sweep.fBar->GetResumeEntry() == 0)
         {
-            if(!isMultithreading)
-                cout << "\rBarST>> Processed " << k + 1 << " events" << flush;
+            if(sweep.fIsSharingWaveforms)
+                sweep.fBar->CopySamplingTimes(*bar);
             else
-                cout << "\rBarWT" << threadID << ">> Processed " << k + 1 << " events" << flush;
+                sweep.fBar->SetSamplingTimes();
         }
+        else if(bar->GetResumeEntry() == 0 && !sweep.fBar->GetDAQ()->fIsBinSizeConstant)
+            sweep.fIsSharingWaveforms = false; // its recovered grid is not the new one of the main generator
+        firstEntry = min(firstEntry, sweep.fBar->GetResumeEntry());
+    }
+
+    // Event loop
+    string prefix = !isMultithreading ? "BarST>> " : "BarWT" + to_string(threadID) + ">> ";
+    if(isReplay)
+        Bartender_Replay(bar, cache, firstEntry, nEntries, prefix);
+    else
+        Bartender_Loop(bar, mc, firstEntry, nEntries, sweepTargets, overlay.get(), prefix);
+    if(overlay)
+    {
+        overlay->Close();
+        cout << "Background library of " << overlay->GetEntries() << " events written to " << overlayFilename << endl;
     }
-    cout << endl;
 
     // Save data
     bar->SaveBar();
+    bar->PrintIOReport();
+    for(const SweepTarget &sweep : sweepTargets)
+    {
+        sweep.fBar->SaveBar();
+        sweep.fBar->PrintIOReport();
+    }
 
     auto end_chrono = chrono::high_resolution_clock::now();
     chrono::duration<double> duration = end_chrono - start_chrono;
+    Trace::Stop();
 
     // Single-thread summary
-    if(!isMultithreading)
+    if(!isMultithreading && !overlay)
     {
-        Bartender_Summary(sipmFilename, bar->GetID(), duration.count());
+        Bartender_Summary(sipmFilename, bar->GetID(), duration.count(), autotuneReport);
+        for(const char *sweepFilename : sweepFilenames)
+            Bartender_Summary(sweepFilename, bar->GetID(), duration.count());
     }
 
     // Free memory
-    lyso->ResetBranchAddresses();
-    delete fT_F, fT_B, fCh_F, fCh_B;
+    mc.Close();
     delete sipm;
     delete bar;
+    for(const SweepTarget &sweep : sweepTargets)
+        delete sweep.fBar;
 
     // Finally
     return 0;
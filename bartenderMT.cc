@@ -1,27 +1,60 @@
+#include <cstdio>
 #include <cstdlib>
 #include <thread>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <iterator>
 #include <unistd.h>
 #include <vector>
 #include <chrono>
 
 #include "summary.hh"
+#include "trace.hh"
 
 
 using namespace std;
 
 
-void launchProcess(int MCID, const char* sipmFilename, int threadID)
+// Converte un argomento in un intero, senza accettare caratteri in coda
+bool parseInt(const char *arg, int &value)
 {
-    // Genera il nome del file di output basato sul threadID
+    char *end;
+    long parsed = strtol(arg, &end, 10);
+    if(end == arg || *end != '\0')
+        return false;
+
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+
+
+// Percorso di bartender_lyso, nella stessa cartella di questo eseguibile
+string bartenderPath(const char *argv0)
+{
+    string self(argv0);
+    size_t slash = self.find_last_of('/');
+    if(slash == string::npos)
+        return "bartender_lyso";
+    return self.substr(0, slash + 1) + "bartender_lyso";
+}
+
+
+
+void launchProcess(string bartender, string inputDir, int MCID, const char* sipmFilename, int threadID, string traceFilename, string autotuneArgs)
+{
+    // Genera il nome del file di input basato sul threadID
     ostringstream mcFile;
-    mcFile << "/home/lorenzo/MEG_Project/Simulazioni/MC_LYSO/build_mt/RootFiles/" << MCID << "/MCID_" << MCID << "_t" << threadID << ".root";
+    mcFile << inputDir << "/MCID_" << MCID << "_t" << threadID << ".root";
 
-    // Costruisci il comando con il nome del file di output e il SiPM.mac
+    // Costruisci il comando con il nome del file di input e il SiPM.mac
     ostringstream command;
-    command << "./bartender " << mcFile.str() << " " << sipmFilename << " " << threadID;
+    command << "\"" << bartender << "\" \"" << mcFile.str() << "\" " << sipmFilename << " " << threadID;
+    if(!traceFilename.empty())
+        command << " --trace " << traceFilename;
+    if(!autotuneArgs.empty())
+        command << " --autotune " << autotuneArgs;
 
     // Esegui il comando
     system(command.str().c_str());
@@ -31,16 +64,41 @@ void launchProcess(int MCID, const char* sipmFilename, int threadID)
 
 int main(int argc, char** argv)
 {
-    if(argc < 3)
+    const string usage = string("Usage: ") + argv[0] + " MCID sipmFilename inputDir [numFiles] [--trace file.json] [--autotune events MB]\n"
+        "  inputDir holds the MC files MCID_<MCID>_t<i>.root of the workers";
+    int MCID;
+    if(argc < 4 || !parseInt(argv[1], MCID))
     {
-        cerr << "Usage: " << argv[0] << " MCID sipmFilename [numFiles]" << endl;
+        cerr << usage << endl;
         return 1;
     }
 
     // Get input files
-    int MCID = stoi(argv[1]);
     const char *sipmFilename = argv[2];
-    int numFiles = (argc > 3) ? stoi(argv[3]) : 16;
+    const string inputDir = argv[3];
+    const string bartender = bartenderPath(argv[0]);
+    int numFiles = 16;
+    string traceFilename, autotuneArgs;
+    for(int i = 4; i < argc; i++)
+    {
+        if(string(argv[i]) == "--trace" && i + 1 < argc)
+            traceFilename = argv[++i];
+        else if(string(argv[i]) == "--autotune" && i + 2 < argc)
+        {
+            autotuneArgs = string(argv[i+1]) + " " + argv[i+2];
+            i += 2;
+        }
+        else if(!parseInt(argv[i], numFiles) || numFiles <= 0)
+        {
+            cerr << "Invalid argument " << argv[i] << endl << usage << endl;
+            return 1;
+        }
+    }
+
+    // Each worker traces itself, the timelines are merged at the end
+    vector<string> traceFilenames;
+    for(int i = 0; i < numFiles && !traceFilename.empty(); i++)
+        traceFilenames.push_back(traceFilename.substr(0, traceFilename.find_last_of('.')) + "_t" + to_string(i) + ".json");
 
     auto start_chrono = chrono::high_resolution_clock::now();
 
@@ -51,7 +109,7 @@ int main(int argc, char** argv)
     for(int i = 0; i < numFiles; i++)
     {
         // Avvia il processo in un nuovo thread, passando l'ID del thread
-        threads[i] = thread(launchProcess, MCID, sipmFilename, i);
+        threads[i] = thread(launchProcess, bartender, inputDir, MCID, sipmFilename, i, traceFilename.empty() ? string() : traceFilenames[i], autotuneArgs);
     }
 
     // Attendi che tutti i thread terminino
@@ -65,7 +123,23 @@ int main(int argc, char** argv)
 
     cout << "Duration: " << duration.count() << " s" << endl;
 
-    Bartender_Summary(sipmFilename, MCID, duration.count());
+    if(!traceFilename.empty() && Trace::Merge(traceFilenames, traceFilename))
+        cout << "Trace written to " << traceFilename << endl;
+
+    // Each worker tunes its own output, the reports are collected here
+    string notes;
+    for(int i = 0; i < numFiles && !autotuneArgs.empty(); i++)
+    {
+        string reportFilename = "Autotune_" + to_string(MCID) + "_t" + to_string(i) + ".txt";
+        ifstream report(reportFilename);
+        if(!report)
+            continue;
+        notes += "Worker " + to_string(i) + ":\n" + string(istreambuf_iterator<char>(report), istreambuf_iterator<char>());
+        report.close();
+        remove(reportFilename.c_str());
+    }
+
+    Bartender_Summary(sipmFilename, MCID, duration.count(), notes);
 
     return 0;
 }
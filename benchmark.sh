@@ -0,0 +1,108 @@
+#!/bin/bash
+#
+# End-to-end scaling benchmark of bartender, run from the build directory:
+#
+#   ./benchmark.sh [results.csv]
+#
+# For every combination of processes, photons per detector and output
+# settings it generates the inputs with bartender_genmc, runs that many
+# bartender processes in parallel (like bartenderMT) and appends one CSV row:
+#
+#   mode,processes,photons,compression,sink,events,wall_s,events_per_s,
+#   photons_per_s,efficiency,mb_written,mb_per_s
+#
+# "strong" runs split EVENTS among the processes, "weak" runs give EVENTS to
+# each of them; the efficiency is relative to the run with one process and the
+# same photons and output settings. The matrix is set with the variables
+# below, e.g.
+#
+#   PROCESSES="1 2 4 8 16" PHOTONS="500 5000" ./benchmark.sh
+
+set -e
+
+CSV=${1:-benchmark.csv}
+BARTENDER=${BARTENDER:-./bartender_lyso}
+GENMC=${GENMC:-./bartender_genmc}
+MAC=${MAC:-SiPM.mac}
+EVENTS=${EVENTS:-200}
+PROCESSES=${PROCESSES:-"1 2 4 8"}
+PHOTONS=${PHOTONS:-"100 1000 5000"}
+COMPRESSIONS=${COMPRESSIONS:-"ZLIB_1 LZ4_4 ZSTD_5"}
+SINKS=${SINKS:-"file binary"}
+MODES=${MODES:-"strong weak"}
+MCID=${MCID:-900000}
+
+WORKDIR=$(mktemp -d bench.XXXX)
+trap 'rm -rf "$WORKDIR"' EXIT
+mkdir -p RootFiles
+
+echo "mode,processes,photons,compression,sink,events,wall_s,events_per_s,photons_per_s,efficiency,mb_written,mb_per_s" > "$CSV"
+
+for mode in $MODES; do
+for photons in $PHOTONS; do
+for compression in $COMPRESSIONS; do
+for sink in $SINKS; do
+    # Output settings of this row
+    mac="$WORKDIR/bench.mac"
+    sed -e "s/^Compression = .*/Compression = ${compression/_/ }/" \
+        -e "s/^Output sink = .*/Output sink = $sink/" \
+        -e "s/^Checkpoint every = .*/Checkpoint every = 0 events/" "$MAC" > "$mac"
+
+    reference=""
+    for procs in $PROCESSES; do
+        if [ "$mode" = "strong" ]; then
+            perProc=$(( (EVENTS + procs - 1) / procs ))
+        else
+            perProc=$EVENTS
+        fi
+
+        # Inputs, one per process, outside the timed region
+        for (( t = 0; t < procs; t++ )); do
+            "$GENMC" "$WORKDIR/MCID_${MCID}_t$t.root" -n $perProc --photons $photons -s $(( t + 1 )) > /dev/null
+        done
+        rm -f RootFiles/BarID_${MCID}_t*
+
+        start=$(date +%s.%N)
+        pids=()
+        for (( t = 0; t < procs; t++ )); do
+            "$BARTENDER" "$WORKDIR/MCID_${MCID}_t$t.root" "$mac" $t > "$WORKDIR/log_t$t.txt" 2>&1 &
+            pids+=($!)
+        done
+        failed=0
+        for (( t = 0; t < procs; t++ )); do
+            if ! wait ${pids[$t]}; then
+                echo "Process $t failed ($mode, $procs processes, $photons photons, $compression, $sink):" >&2
+                cat "$WORKDIR/log_t$t.txt" >&2
+                failed=1
+            fi
+        done
+        [ $failed -eq 0 ] || exit 1
+        end=$(date +%s.%N)
+
+        bytes=$(cat RootFiles/BarID_${MCID}_t* 2>/dev/null | wc -c)
+        rm -f RootFiles/BarID_${MCID}_t*
+
+        events=$(( perProc * procs ))
+        row=$(awk -v s=$start -v e=$end -v n=$events -v p=$photons -v b=$bytes 'BEGIN {
+            w = e - s; printf "%.3f,%.2f,%.0f,%.2f,%.2f", w, n / w, 2 * p * n / w, b / 1e6, b / 1e6 / w }')
+        wall=${row%%,*}
+
+        # Strong scaling: speed-up over procs; weak scaling: time ratio
+        if [ -z "$reference" ]; then
+            reference=$wall
+            efficiency=1.000
+        elif [ "$mode" = "strong" ]; then
+            efficiency=$(awk -v r=$reference -v w=$wall -v n=$procs -v n1=${PROCESSES%% *} 'BEGIN { printf "%.3f", (r / w) * n1 / n }')
+        else
+            efficiency=$(awk -v r=$reference -v w=$wall 'BEGIN { printf "%.3f", r / w }')
+        fi
+
+        IFS=, read -r wall eps pps mb mbps <<< "$row"
+        echo "$mode,$procs,$photons,${compression/_/ },$sink,$events,$wall,$eps,$pps,$efficiency,$mb,$mbps" | tee -a "$CSV"
+    done
+done
+done
+done
+done
+
+echo "Results in $CSV"
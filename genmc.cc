@@ -0,0 +1,101 @@
+/**
+ * @file genmc.cc
+ * @brief Definition of the main function of bartender_genmc, the generator of
+ * synthetic MC inputs for the benchmarks.
+ */
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <memory>
+#include <tuple>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TRandom3.h>
+
+#include "globals.hh"
+
+
+using namespace std;
+
+
+/**
+ * @brief Main of bartender_genmc.
+ *
+ * It writes a "lyso" TTree with the branches read by bartender: for each event
+ * a Poisson number of photons per detector, with uniform channel and arrival
+ * time from the LYSO exponential decay. The occupancy is set by --photons.
+ *
+ * > ./bartender_genmc MCID_1.root -n 1000 --photons 2000 -s 1 --channels 115
+ */
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " MCID_<id>.root [-n events] [--photons mean per detector] [-s seed] [--channels N]" << endl;
+        return 1;
+    }
+
+    const char *filename = argv[1];
+    Int_t nEvents = 1000;
+    Double_t meanPhotons = 1000;
+    UInt_t seed = 1;
+    Int_t channels = CHANNELS;
+    for(int i = 2; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            nEvents = stoi(argv[++i]);
+        else if(strcmp(argv[i], "--photons") == 0 && i + 1 < argc)
+            meanPhotons = stod(argv[++i]);
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = stoul(argv[++i]);
+        else if(strcmp(argv[i], "--channels") == 0 && i + 1 < argc)
+            channels = stoi(argv[++i]);
+        else
+        {
+            cerr << "Unknown option " << argv[i] << endl;
+            return 1;
+        }
+    }
+
+    const Double_t tauScint = 40.; // LYSO decay time [ns]
+    TRandom3 rand(seed);
+
+    unique_ptr<TFile> file(TFile::Open(filename, "RECREATE"));
+    TTree lyso("lyso", "lyso");
+
+    Int_t event, nHits_F, nHits_B;
+    vector<Double_t> t_F, t_B;
+    vector<Int_t> ch_F, ch_B;
+    lyso.Branch("Event", &event);
+    lyso.Branch("NHits_F", &nHits_F);
+    lyso.Branch("NHits_B", &nHits_B);
+    lyso.Branch("T_F", &t_F);
+    lyso.Branch("Ch_F", &ch_F);
+    lyso.Branch("T_B", &t_B);
+    lyso.Branch("Ch_B", &ch_B);
+
+    for(event = 0; event < nEvents; event++)
+    {
+        for(auto side : {make_tuple(&nHits_F, &ch_F, &t_F), make_tuple(&nHits_B, &ch_B, &t_B)})
+        {
+            Int_t &nHits = *get<0>(side);
+            nHits = rand.Poisson(meanPhotons);
+            get<1>(side)->resize(nHits);
+            get<2>(side)->resize(nHits);
+            for(Int_t j = 0; j < nHits; j++)
+            {
+                (*get<1>(side))[j] = rand.Integer(channels);
+                (*get<2>(side))[j] = rand.Exp(tauScint);
+            }
+        }
+        lyso.Fill();
+    }
+
+    lyso.Write();
+    file->Close();
+
+    cout << "Written " << nEvents << " events with " << meanPhotons << " photons per detector on average to " << filename << endl;
+    return 0;
+}
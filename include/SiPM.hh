@@ -1,12 +1,34 @@
 /**
  * @file SiPM.hh
- * @brief Definition of the struct SiPM
+ * @brief Definition of the structs SiPM and SiPMNoise
  */
 #ifndef SIPM_HH
 #define SIPM_HH
 
 #include <string>
 
+#include <Rtypes.h>
+
+/**
+ * @brief Struct for storing the uncorrelated and correlated noise of a SiPM
+ * type at its working point.
+ */
+struct SiPMNoise
+{
+    Double_t fDarkRate = 0; /**< @brief Dark count rate [MHz] of a channel */
+    Double_t fCrosstalk = 0; /**< @brief Probability of prompt crosstalk of an avalanche */
+    Double_t fAfterpulse = 0; /**< @brief Probability of an afterpulse of an avalanche */
+    Double_t fAfterpulseTau = 50; /**< @brief Mean delay [ns] of the afterpulses */
+
+    /** @brief Returns whether any noise pulse is added. */
+    inline Bool_t IsEnabled() const { return fDarkRate > 0 || fCrosstalk > 0 || fAfterpulse > 0; }
+    inline bool operator==(const SiPMNoise &other) const
+    {
+        return fDarkRate == other.fDarkRate && fCrosstalk == other.fCrosstalk && fAfterpulse == other.fAfterpulse && fAfterpulseTau == other.fAfterpulseTau;
+    }
+};
+
+
 /**
  * @brief Struct for storing MPPC/SiPM settings for waveform generation.
  */
@@ -14,10 +36,12 @@ struct SiPM
 {
     std::string fBrand; /**< @brief Manufacturer's brand of SiPM */
     std::string fTypeNo; /**< @brief Type number of the SiPM */
-    
+
     Float_t fV; /**< @brief Supply Voltage [V] for the environment working point */
     Float_t fT; /**< @brief Temperature [°C] for the environment working point */
+
+    SiPMNoise fNoise; /**< @brief Dark counts, crosstalk and afterpulses of this type */
 };
 
 
-#endif  // SIPM_HH
\ No newline at end of file
+#endif  // SIPM_HH
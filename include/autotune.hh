@@ -0,0 +1,45 @@
+/**
+ * @file autotune.hh
+ * @brief Declaration of the function @ref Bartender_Autotune(), the choice of
+ * the output settings from a short calibration pass (--autotune)
+ *
+ * A separate generator, configured with the same mac, writes the first MC
+ * entries to a temporary file once for each candidate: first the compression
+ * algorithms and levels, then the basket sizes with the fastest compression.
+ * For each candidate the events/s, the MB/s written and the memory held by
+ * the baskets are measured. The candidates above the memory budget are
+ * discarded; among those within @ref AUTOTUNE_SPEED_TOLERANCE of the fastest,
+ * the one with the smallest output wins. The generator of the run is left
+ * untouched, apart from its output settings, so that its random sequences
+ * are those of a run without --autotune.
+ */
+#ifndef AUTOTUNE_HH
+#define AUTOTUNE_HH
+
+#include <string>
+
+#include <Rtypes.h>
+
+#include "bar.hh"
+
+constexpr Double_t AUTOTUNE_SPEED_TOLERANCE = 0.05; /**< @brief Relative loss of events/s accepted for a smaller output */
+
+/**
+ * @brief Chooses the compression and the basket sizes of the output of bar.
+ *
+ * Only the file and rntuple sinks are tuned; bar must not have opened its
+ * output yet. The settings of the mac are one of the candidates.
+ *
+ * @param mcFilename MC file, whose first entries are the sample
+ * @param sipmFilename Mac file of bar
+ * @param threadID Worker ID of bar (-1 for a single process)
+ * @param nEvents Entries of the sample
+ * @param memoryBudget Maximum memory [bytes] of the baskets (0 for no limit),
+ * also set as the Memory cap of the run
+ * @param report Filled with the measurements and the choice, for the summary
+ * @return false if nothing was tuned (the output settings are unchanged)
+ */
+Bool_t Bartender_Autotune(BarLYSO *bar, const char *mcFilename, const char *sipmFilename, Int_t threadID, Long64_t nEvents, Long64_t memoryBudget, std::string &report);
+
+
+#endif  // AUTOTUNE_HH
@@ -11,15 +11,34 @@
 #include <cfloat>
 #include <string>
 #include <regex>
+#include <deque>
 
 #include <TH3D.h>
 #include <TRandom3.h>
 #include <TTree.h>
 #include <TMath.h>
 #include <TFile.h>
+#include <TParameter.h>
+#include <TBranch.h>
+#include <TObjArray.h>
+#include <Compression.h>
+#include <TSystem.h>
 
 #include "globals.hh"
 #include "daq.hh"
+#include "output.hh"
+#include "features.hh"
+#include "photon.hh"
+#include "pulse.hh"
+#include "shmring.hh"
+#include "rntuplesink.hh"
+#include "flatexport.hh"
+#include "overlay.hh"
+#include "photoncache.hh"
+#include "resampler.hh"
+#include "filter.hh"
+#include "calibration.hh"
+#include "SiPM.hh"
 
 /**
  * @brief Class for managing waveform construction for all events and channels.
@@ -27,6 +46,15 @@
 class BarLYSO
 {
 public:
+    /**
+     * @brief Constructor of the class for the embedded use, without files.
+     *
+     * The synthesis works entirely in memory: configure it, call @ref
+     * SetParsDistro() and @ref SetSamplingTimes(), then @ref ProcessEvent()
+     * for each event. An output file can still be attached with @ref
+     * SetOutputFilename() and @ref OpenOutput().
+     */
+    BarLYSO();
     /** 
      * @brief Constructor of the class.
      *
@@ -50,8 +78,30 @@ public:
      * fHisto_Tau_rise and @ref fHisto_Tau_dec. It specifically considers
      * entries within the charge range [@ref fChargeCuts[0],
      * @ref fChargeCuts[1]] and with a converged fit status.
+     *
+     * Pulse models with more than three parameters (see @ref
+     * SetPulseModel()) are not binned: the accepted rows of their columns are
+     * stored in @ref fPulseRows and resampled as a whole, which also keeps the
+     * correlations between the parameters.
      */
     void SetParsDistro();
+    /**
+     * @brief Selects the model of the 1-Phel waveform: "2exp" (default),
+     * "3exp" or "fastslow" (see pulse.hh).
+     *
+     * The model is a template parameter of the synthesis loops, so that its
+     * evaluator is inlined; this only selects the instantiation. To be called
+     * before @ref SetParsDistro().
+     */
+    void SetPulseModel(const std::string &model);
+    /**
+     * @brief Samples the parameters of one 1-Phel waveform of the current
+     * model, from @ref hPars or from @ref fPulseRows (see the Sample() of
+     * the models in pulse.hh).
+     *
+     * @param pars Array of at least @ref MAX_PULSE_PARS values
+     */
+    inline void SamplePulsePars(Double_t *pars) { fSamplePulse(hPars, fPulseRows, fRandPars, pars); }
     /**
      * @brief Method to initialize the entire @ref fFront and @ref fBack with a
      * noise baseline.
@@ -95,6 +145,96 @@ public:
      * Wave_OnePhel() as the timePhel (\f$ t_{phel} \f$) input parameter
      */
     void SetBackWaveform(Int_t channel, Double_t start);
+    /**
+     * @brief Method to add the 1-Phel waveforms of all the photons of the
+     * event detected by the Front-Detector.
+     *
+     * Channels with up to @ref fApproxThreshold photons (or all channels, if
+     * the approximation is disabled) go through @ref SetFrontWaveform()
+     * photon by photon; the others are built with @ref AddApproxChannel().
+     *
+     * @param nHits Number of photons
+     * @param channels Channel index of each photon
+     * @param starts Arrival time of each photon
+     */
+    void SetFrontWaveforms(Int_t nHits, const Int_t *channels, const Double_t *starts);
+    /**
+     * @brief Method to add the 1-Phel waveforms of all the photons of the
+     * event detected by the Back-Detector. See @ref SetFrontWaveforms().
+     */
+    void SetBackWaveforms(Int_t nHits, const Int_t *channels, const Double_t *starts);
+    /**
+     * @brief Compares the exact and the approximated synthesis of a channel
+     * for several numbers of photons, and writes the results in a text file.
+     *
+     * For each number of photons, channels are synthesized with photon times
+     * from an exponential scintillation decay, both photon by photon and
+     * with @ref AddApproxChannel(). The mean and RMS of amplitude, charge and
+     * peak time, and the time spent per channel, are reported for the two
+     * methods. It's meant to choose @ref fApproxThreshold.
+     *
+     * @param filename Name of the report file
+     */
+    void ValidateApprox(const char *filename);
+    /**
+     * @brief Prepares the free-running mode: constant bins and empty ring
+     * buffers. To be called before @ref SetSamplingTimes().
+     *
+     * In this mode the events arrive on a global timeline as a Poisson
+     * process with rate @ref fFreeRate. Their photons are synthesized once
+     * into a ring buffer per channel, where the pulses can cross the window
+     * boundaries, and for each event the window of @ref GetSamplings()
+     * samples starting ZERO_TIME_BIN before its arrival is extracted,
+     * digitized and saved with @ref SaveEvent(), together with whatever
+     * piles up from the neighbouring events.
+     */
+    void BeginFreeRunning();
+    /**
+     * @brief Adds an event to the timeline and saves the windows that no
+     * later event can reach any more.
+     */
+    void AddFreeRunningEvent(Int_t event, Int_t nHits_F, const Int_t *channels_F, const Double_t *starts_F, Int_t nHits_B, const Int_t *channels_B, const Double_t *starts_B);
+    /**
+     * @brief Saves the windows still pending at the end of the run.
+     */
+    void FlushFreeRunning();
+    /**
+     * @brief Sets the geometry: channels per detector and samplings per
+     * waveform.
+     *
+     * It resizes all the containers and selects the instantiation of the
+     * inner loops: 115 channels with 1024, 2048 or 4096 samplings, and the
+     * 3x3 prototype with 9 channels and 1024 samplings, have compile-time
+     * bounds; any other geometry (and the reference mode) uses the generic
+     * loops. To be called before @ref OpenOutput() and @ref
+     * SetSamplingTimes().
+     */
+    void SetGeometry(Int_t channels, Int_t samplings);
+    /**
+     * @brief Sets the channels to synthesize and the events to process.
+     *
+     * The masked channels are left empty in @ref fFront and @ref fBack: they
+     * are neither synthesized nor digitized, and are stored as empty vectors
+     * in the lyso_wfs tree (as zeros by the sinks with a fixed layout). An
+     * invalid list of channels selects all of them.
+     */
+    void SetFilter(const EventFilter &filter);
+    inline const EventFilter &GetFilter() const { return fFilter; } /**< @brief Returns the selection of channels and events. */
+    /**
+     * @brief Synthesizes and digitizes one event from its hit arrays.
+     *
+     * It chains @ref InitializeBaselines(), @ref SetFrontWaveforms(), @ref
+     * SetBackWaveforms() and @ref SaveEvent(): the waveforms are then
+     * available through @ref GetFront() and @ref GetBack() (or @ref
+     * FillBuffers()) until the next event, and go to the output sinks only if
+     * @ref OpenOutput() was called.
+     */
+    void ProcessEvent(Int_t event, Int_t nHits_F, const Int_t *channels_F, const Double_t *starts_F, Int_t nHits_B, const Int_t *channels_B, const Double_t *starts_B);
+    /**
+     * @brief Copies the waveforms of the current event into two flat
+     * [@ref GetChannels()][@ref GetSamplings()] buffers (e.g. numpy arrays).
+     */
+    void FillBuffers(Float_t *front, Float_t *back) const;
     /**
      * @brief Saves all the samples from @ref fFront and @ref fBack into a text
      * file.
@@ -107,8 +247,105 @@ public:
      */
     void SaveEvent();
     void SaveBar();
+    /**
+     * @brief Opens the output file and creates (or recovers) the output
+     * TTrees.
+     *
+     * The name of the file is the one determined by the constructor. With
+     * isResume the partial file left by an interrupted run is reopened: the
+     * trees, the sampling times and the states of the random generators are
+     * recovered from the last checkpoint, and @ref GetResumeEntry() returns
+     * the first entry still to be processed. If no valid checkpoint is found
+     * the run starts from scratch.
+     *
+     * @param isResume Whether to resume an interrupted run
+     * @return Whether the output file could be created (or recovered)
+     */
+    Bool_t OpenOutput(Bool_t isResume = false);
+    /**
+     * @brief Closes the output file and the sinks, so that the generator
+     * can be reused for another run with @ref OpenOutput().
+     *
+     * @ref SaveBar() must be called first to keep the data.
+     */
+    void CloseOutput();
+    /**
+     * @brief Sets the run ID (@ref fID) and the default output filename from
+     * the name of a new MC input, for a generator reused across runs.
+     */
+    void SetMCFilename(const char *mcFilename);
+    /**
+     * @brief Saves a checkpoint of the output file, if one is due.
+     *
+     * Every @ref OutputSettings::fCheckpointEvents entries, the output
+     * TTrees are auto-saved together with a progress record (the last
+     * processed entry and the states of the random generators), so that an
+     * interrupted run can be resumed with @ref OpenOutput(). It must be
+     * called for every processed entry, also when no checkpoint is due:
+     * @ref SaveBar() records the last one.
+     *
+     * @param entry Index of the MC entry just processed
+     */
+    void Checkpoint(Long64_t entry);
+    /**
+     * @brief Prints, for each branch of the output trees, the bytes written
+     * and the compression ratio.
+     */
+    void PrintIOReport();
+    /**
+     * @brief Returns the memory [bytes] held by the baskets of the output
+     * trees, with their current sizes.
+     */
+    Long64_t GetBasketMemory() const;
+    /**
+     * @brief Returns whether the other generator samples its waveforms on the
+     * same time grid (same sampling speed and bin-width settings).
+     */
+    Bool_t HasSameSampling(const BarLYSO &other) const;
+    /**
+     * @brief Takes the sampling times from another generator, instead of
+     * calling @ref SetSamplingTimes().
+     */
+    void CopySamplingTimes(const BarLYSO &other);
+    /**
+     * @brief Takes the noiseless waveforms of the current event from another
+     * generator sharing the same time grid (see @ref HasSameSampling()).
+     *
+     * Used by the sweep mode: the event is synthesized once and only the
+     * gain, the noise and the output of @ref SaveEvent() are repeated for
+     * each DAQ configuration. It must be called after @ref
+     * InitializeBaselines() and before the other generator's @ref
+     * SaveEvent().
+     */
+    void CopyWaveforms(const BarLYSO &other);
+    /**
+     * @brief Synthesizes the waveforms of the current event on this
+     * generator's time grid from the photons recorded by another generator.
+     *
+     * Used by the sweep mode when the sampling settings differ: the MC read
+     * and the sampling from @ref hPars are not repeated.
+     */
+    void SynthesizeFrom(const BarLYSO &other);
+    /**
+     * @brief Synthesizes the waveforms of the current event from photons
+     * whose parameters were sampled with the given pulse model, e.g. those of
+     * the lyso_photons tree of a previous run (see photoncache.hh).
+     *
+     * The parameters are used as they are with the same pulse model, and
+     * sampled again with another one.
+     */
+    void SynthesizePhotons(const std::vector<Photon> &photons_F, const std::vector<Photon> &photons_B, const std::string &pulseModel);
 
     inline void SetSigmaNoise(Float_t newSigmaNoise) { fSigmaNoise = newSigmaNoise; } /**< @brief Set @ref fSigmaNoise, the noise of the DAQ. */
+    inline void SetOverlayLibrary(std::string filename) { fOverlayFilename = filename; } /**< @brief Set the library of background waveforms mixed into each event (empty disables the overlay). */
+    inline void SetOverlayEvents(Int_t events) { fOverlayEvents = events; } /**< @brief Set @ref fOverlayEvents, the background events overlaid on each event. */
+    inline void SetOverlayWindow(Double_t window) { fOverlayWindow = window; } /**< @brief Set @ref fOverlayWindow, the maximum time shift [ns] of the overlaid events. */
+    inline void SetSiPMNoise(const SiPMNoise &noise) { fSiPMNoise = noise; } /**< @brief Set @ref fSiPMNoise, the dark counts, crosstalk and afterpulses added to each event. */
+    inline const SiPMNoise &GetSiPMNoise() const { return fSiPMNoise; } /**< @brief Returns @ref fSiPMNoise. */
+    inline void SetCalibrationTable(std::string filename) { fCalibrationFilename = filename; } /**< @brief Set the per-channel calibration table of the DAQ (empty for the global gain and noise, see @ref LoadCalibrationTable()). */
+    inline void SetFreeRunningRate(Double_t rate) { fFreeRate = rate; } /**< @brief Set @ref fFreeRate, the event rate [MHz] of the free-running mode (0 disables it). */
+    inline Bool_t IsFreeRunning() const { return fFreeRate > 0; } /**< @brief Returns whether the free-running mode is enabled. */
+    inline void SetApproxThreshold(Int_t newApproxThreshold) { fApproxThreshold = newApproxThreshold; } /**< @brief Set @ref fApproxThreshold, the number of photons above which a channel is approximated. */
     inline void SetInputFilename(std::string newInputFilename) { fInputFilename = newInputFilename; } /**< @brief Set the name of the text file of the best fit parameters data. */
     /**
      * @brief Set the cuts in the charge spectrum of input best fit parameters
@@ -153,20 +390,73 @@ public:
     inline void SetEvents(Int_t events) { EVENTS = events; } 
     inline Int_t GetEvents() const { return EVENTS; } /**< @brief Returns the number of events in the run. */
     inline Int_t GetID() const { return fID; } /**< @brief Returns the ID of the Monte Carlo. */
+    inline Int_t GetChannels() const { return fChannels; } /**< @brief Returns the number of channels per detector. */
+    inline Int_t GetSamplings() const { return fSamplings; } /**< @brief Returns the number of samplings per waveform. */
     inline DAQ *GetDAQ() const { return fDAQ; }
+    inline OutputSettings *GetOutput() { return &fOutput; } /**< @brief Returns the settings of the output file. */
+    inline FeatureSettings *GetFeatureSettings() { return &fFeatureSettings; } /**< @brief Returns the settings of the inline feature extraction. */
+    inline Long64_t GetResumeEntry() const { return fResumeEntry; } /**< @brief Returns the first MC entry to be processed (non-zero only for resumed runs). */
+    inline void SetOutputFilename(const std::string &newOutputFilename) { fOutputFilename = newOutputFilename; } /**< @brief Set the name of the output file (to be called before @ref OpenOutput()). */
+    inline const std::string &GetOutputFilename() const { return fOutputFilename; } /**< @brief Returns the name of the output file. */
+    inline void SetReferenceMode(Bool_t isReference) { fIsReference = isReference; SelectKernels(); } /**< @brief Force the plain scalar synthesis, disabling every faster path (see bartender_validate). */
+    inline const std::vector<std::vector<Float_t>> &GetFront() const { return fFront; } /**< @brief Returns the Front-Detector waveforms of the current event. */
+    inline const std::vector<std::vector<Float_t>> &GetBack() const { return fBack; } /**< @brief Returns the Back-Detector waveforms of the current event. */
+    inline const std::vector<Char_t> &GetActive_F() const { return fActive_F; } /**< @brief Returns whether each Front-Detector channel received a signal: before @ref SaveEvent() the waveforms of the others are stale. */
+    inline const std::vector<Char_t> &GetActive_B() const { return fActive_B; } /**< @brief Returns whether each Back-Detector channel received a signal: before @ref SaveEvent() the waveforms of the others are stale. */
+    inline const std::vector<std::vector<Float_t>> &GetTimes_F() const { return fTimes_F; } /**< @brief Returns the sampling times of the Front-Detector. */
+    inline const std::vector<std::vector<Float_t>> &GetTimes_B() const { return fTimes_B; } /**< @brief Returns the sampling times of the Back-Detector. */
+    /**
+     * @brief Returns the sampling times of a channel in the current event:
+     * its grid of @ref fTimePool with the jitter pool, otherwise those of
+     * @ref GetTimes_F() or @ref GetTimes_B().
+     */
+    inline const std::vector<Float_t> &GetChannelTimes(Bool_t isFront, Int_t channel) const
+    {
+        if(!fTimePool.empty())
+            return fTimePool[(isFront ? fTimeIdx_F : fTimeIdx_B)[channel]];
+        return (isFront ? fTimes_F : fTimes_B)[channel];
+    }
+    /**
+     * @brief Seeds all the random generators, to make the run reproducible.
+     */
+    void SetSeed(UInt_t seed);
+    inline void SetRecordPhotons(Bool_t isRecording) { fIsRecordingPhotons = isRecording; } /**< @brief Enable the recording of the photons of each event (see @ref SynthesizeFrom()). */
+    inline const std::string &GetPulseModel() const { return fPulseModel; } /**< @brief Returns the name of the model of the 1-Phel waveform. */
 
 private:
     Int_t fEvent; /**< @brief Number of events in the run */
     Int_t fID; /**< @brief Run ID of the Monte Carlo */
     Int_t EVENTS;
     Int_t fThreadID;
+    Int_t fChannels = CHANNELS; /**< @brief Number of channels per detector */
+    Int_t fSamplings = SAMPLINGS; /**< @brief Number of samplings per waveform */
 
     std::vector<std::vector<Float_t>> fFront; /**< @brief Container for Front-Detector waveforms: a 3-dimensional matrix with indices for event, channel, and bin. */  
     std::vector<std::vector<Float_t>> fBack;  /**< @brief Container for Back-Detector waveforms: a 3-dimensional matrix with indices for event, channel, and bin. */
     std::vector<std::vector<Float_t>> fTimes_F;
     std::vector<std::vector<Float_t>> fTimes_B;
+    std::vector<std::vector<Float_t>> fTimePool; /**< @brief Pool of jittered sampling grids [grid][bin], if the grids change event by event */
+    std::vector<UShort_t> fTimeIdx_F; /**< @brief Grid of @ref fTimePool of each Front-Detector channel in the current event */
+    std::vector<UShort_t> fTimeIdx_B; /**< @brief Grid of @ref fTimePool of each Back-Detector channel in the current event */
+    /** @brief Returns whether the sampling grids change event by event, drawn from @ref fTimePool. */
+    inline Bool_t IsJitterPool() const { return fDAQ->fJitterPool > 0 && !fDAQ->fIsBinSizeConstant && !IsFreeRunning(); }
+    /** @brief Draws the width [ns] of a bin of the jittered grids. */
+    Float_t DrawBinSize();
+    /**
+     * @brief Assigns to each channel a grid of @ref fTimePool, chosen by a
+     * hash of the event number and the channel. Only the indices are
+     * stored: the grids are read through @ref GetChannelTimes().
+     *
+     * The choice doesn't depend on the order of the events, so that resumed
+     * runs, sweeps and replays see the same grids.
+     */
+    void AssignPoolTimes(Int_t event);
 
-    TH3D *hPars; /**< @brief 3D Histogram of One-Phel waveform parameters from which sampling will occur */
+    TH3D *hPars = nullptr; /**< @brief 3D Histogram of One-Phel waveform parameters from which sampling will occur */
+    std::string fPulseModel = TwoExpPulse::kName; /**< @brief Name of the model of the 1-Phel waveform */
+    Int_t fNPulsePars = TwoExpPulse::kNPars; /**< @brief Number of parameters of the model */
+    const char *const *fPulseColumns = TwoExpPulse::kColumns; /**< @brief Columns of the parameters file read by the model */
+    std::vector<Double_t> fPulseRows; /**< @brief Accepted rows of the parameters file, [row][@ref fNPulsePars] flattened, for the models other than 2exp */
     
     TRandom3 *fRandPars; /**< @brief Random generator for @ref SetFrontWaveform() and @ref SetBackWaveform() */
     TRandom3 *fRandNoise; /**< @brief Random generator for @ref Add_Noise() */
@@ -182,10 +472,115 @@ private:
     DAQ *fDAQ;
 
     std::string GenerateOutputFilename(const char *inputFilename);
+    /**
+     * @brief Recovers trees, sampling times and random generators from the
+     * last checkpoint of the output file. Returns false if the file doesn't
+     * contain a valid checkpoint.
+     */
+    Bool_t RecoverCheckpoint();
+    /**
+     * @brief Writes the progress record (last processed entry and states of
+     * the random generators) into the output file.
+     */
+    void WriteProgress(Long64_t entry);
+    /**
+     * @brief Applies the compression, basket, auto-flush and auto-save
+     * settings of @ref fOutput to the output file and trees.
+     */
+    void ApplyOutputSettings();
+    /**
+     * @brief Creates the shared-memory ring, if it is the sink of the
+     * waveforms.
+     */
+    void OpenShm();
+    /**
+     * @brief Creates the RNTuples of the waveforms, if they are the sink,
+     * with the compression of the output file.
+     */
+    void OpenRNTuple();
+    /**
+     * @brief Opens the flat binary files of the waveforms, if they are the
+     * sink, next to the output file.
+     */
+    void OpenFlat();
+    /**
+     * @brief Maps the library of background waveforms, if set, checking that
+     * it matches the geometry and the sampling speed.
+     */
+    void OpenOverlay();
+    /**
+     * @brief Sums @ref fOverlayEvents random library events, each shifted
+     * by a random time within ±@ref fOverlayWindow, to the noiseless
+     * waveforms of the current event.
+     */
+    void MixOverlay();
  
+    std::string fOutputFilename; /**< @brief Name of the output ROOT file */
+    OutputSettings fOutput; /**< @brief Settings of the output ROOT file */
+    EventFilter fFilter; /**< @brief Selection of the channels and of the events */
+    std::vector<Char_t> fMask_F; /**< @brief Whether each channel of the Front-Detector is synthesized */
+    std::vector<Char_t> fMask_B; /**< @brief Whether each channel of the Back-Detector is synthesized */
+    std::vector<Char_t> fActive_F; /**< @brief Whether each channel of the Front-Detector received a signal in the current event (the others are pure noise, their waveforms are stale) */
+    std::vector<Char_t> fActive_B; /**< @brief Whether each channel of the Back-Detector received a signal in the current event (the others are pure noise, their waveforms are stale) */
+    Long64_t fResumeEntry = 0; /**< @brief First MC entry to be processed, after a resume */
+    Long64_t fLastEntry = -1; /**< @brief Last MC entry processed (saved or skipped), as passed to @ref Checkpoint() */
+
     TFile *fOutFile = nullptr;
     TTree *fOutTree = nullptr;
     TTree *fTimesTree = nullptr;
+    TTree *fFeaturesTree = nullptr;
+    TTree *fPhotonsTree = nullptr; /**< @brief Photon-level cache, if saved */
+    PhotonColumns fPhotonColumns_F; /**< @brief Sorted photons of the Front-Detector, as saved in @ref fPhotonsTree */
+    PhotonColumns fPhotonColumns_B; /**< @brief Sorted photons of the Back-Detector, as saved in @ref fPhotonsTree */
+
+    // Pointers to the containers, needed to reattach the branches of recovered trees
+    std::vector<std::vector<Float_t>> *fFrontPtr = &fFront;
+    std::vector<std::vector<Float_t>> *fBackPtr = &fBack;
+    std::vector<std::vector<Float_t>> *fTimes_FPtr = &fTimes_F;
+    std::vector<std::vector<Float_t>> *fTimes_BPtr = &fTimes_B;
+    std::vector<std::vector<Float_t>*> fFeaturesFloatPtrs; /**< @brief Containers of the Float_t branches of a recovered @ref fFeaturesTree */
+    std::vector<std::vector<Int_t>*> fFeaturesIntPtrs; /**< @brief Containers of the Int_t branches of a recovered @ref fFeaturesTree */
+    std::vector<Short_t> *fPhotonCh_FPtr = &fPhotonColumns_F.fChannel, *fPhotonCh_BPtr = &fPhotonColumns_B.fChannel;
+    std::vector<Double_t> *fPhotonT_FPtr = &fPhotonColumns_F.fTime, *fPhotonT_BPtr = &fPhotonColumns_B.fTime;
+    std::vector<Float_t> *fPhotonPars_FPtr = &fPhotonColumns_F.fPars, *fPhotonPars_BPtr = &fPhotonColumns_B.fPars;
+    std::vector<UShort_t> *fTimeIdx_FPtr = &fTimeIdx_F, *fTimeIdx_BPtr = &fTimeIdx_B;
+    std::vector<std::vector<Float_t>> *fTimePoolPtr = &fTimePool;
+
+    ShmProducer *fShm = nullptr; /**< @brief Shared-memory ring, if it is the sink of the waveforms */
+    Long64_t fShmFallbacks = 0; /**< @brief Events written to the file because the shared-memory ring was full */
+    RNTupleSink *fRNTuple = nullptr; /**< @brief RNTuple writer, if it is the sink of the waveforms */
+    FlatExporter *fFlat = nullptr; /**< @brief Flat binary writer, if it is the sink of the waveforms */
+
+    std::string fOverlayFilename; /**< @brief Library of background waveforms (empty if no overlay) */
+    Int_t fOverlayEvents = 1; /**< @brief Background events overlaid on each event */
+    Double_t fOverlayWindow = 200; /**< @brief Maximum time shift [ns] of the overlaid events, in both directions */
+    OverlayLibrary *fOverlay = nullptr; /**< @brief Mapped library, if the overlay is enabled */
+
+    std::string fCalibrationFilename; /**< @brief Per-channel calibration table (empty for the global DAQ settings) */
+    std::vector<ChannelCalibration> fCalibration_F; /**< @brief Response of each Front-Detector channel (empty for the global DAQ settings) */
+    std::vector<ChannelCalibration> fCalibration_B; /**< @brief Response of each Back-Detector channel (empty for the global DAQ settings) */
+    /**
+     * @brief Reads the calibration table, if set, with the global DAQ
+     * settings as defaults. Called with the sampling times.
+     */
+    void LoadCalibration();
+
+    FeatureSettings fFeatureSettings; /**< @brief Settings of the inline feature extraction */
+    SideFeatures fFeatures_F; /**< @brief Estimators and truth information of the Front-Detector for the current event */
+    SideFeatures fFeatures_B; /**< @brief Estimators and truth information of the Back-Detector for the current event */
+
+    /** @brief Returns the output trees in use. */
+    std::vector<TTree*> GetOutputTrees() const;
+    /**
+     * @brief Creates the branches of the lyso_features tree, or attaches them
+     * to the containers if the tree is recovered from a checkpoint.
+     */
+    void SetFeaturesBranches(Bool_t isRecovered);
+    /**
+     * @brief Creates the branches of the lyso_photons tree, or attaches them
+     * to the columns if the tree is recovered from a checkpoint.
+     */
+    void SetPhotonsBranches(Bool_t isRecovered);
 
     /**
      * @brief Returns the value of the noise.
@@ -196,14 +591,216 @@ private:
      * pedestal's distribution.
      */
     inline Float_t Add_Noise() { return fRandNoise->Gaus(BASELINE, fDAQ->fSigmaNoise); };
+    /**
+     * @brief Returns a sample of a channel without signal: its baseline and
+     * noise, clipped to the range of the ADC.
+     */
+    inline Float_t NoiseSample(const ChannelCalibration &cal, const Float_t *range)
+    {
+        Float_t noise = fRandNoise->Gaus(cal.fBaseline, cal.fSigmaNoise);
+        return TMath::Min(TMath::Max(noise, range[0]), range[1]);
+    }
+    /**
+     * @brief Returns a digitized sample: the signal converted to the gain of
+     * the channel, plus its baseline and noise, clipped to the range of the
+     * ADC.
+     */
+    inline Float_t DigitizeSample(Float_t signal, const ChannelCalibration &cal, const Float_t *range)
+    {
+        Float_t noise = fRandNoise->Gaus(cal.fBaseline, cal.fSigmaNoise);
+        return TMath::Min(TMath::Max(cal.fFactor*signal + noise, range[0]), range[1]);
+    }
     /**
      * @brief Returns the value at t of the analytical form of the One Photo-Electron waveform.
      *
      * \f[
      * \text{wave}(t) = -A \Bigg( \exp \Bigg( -\frac{t - t_{phel}}{\tau_{\text{RISE}}} \Bigg) - \exp \Bigg( -\frac{t - t_{phel}}{\tau_{\text{DEC}}} \Bigg) \Bigg)  \theta( t - t_{phel} )
      * \f] 
+     *
+     * It's the default model, TwoExpPulse; the others are evaluated through
+     * @ref fEvalPulse.
      */
     Float_t Wave_OnePhel(Float_t t, Double_t A, Double_t tau_rise, Double_t tau_dec, Double_t timePhel);
+    /**
+     * @brief Sums a 1-Phel waveform of the current model, with parameters
+     * pars, evaluated on the given sampling times, to a waveform.
+     */
+    inline void AddOnePhel(std::vector<Float_t> &wave, const std::vector<Float_t> &times, const Double_t *pars, Double_t start)
+    {
+        (this->*fAddOnePhelKernel)(wave, times, pars, start);
+    }
+    /** @brief Instantiation of @ref AddOnePhel() for a geometry and a pulse model. */
+    template<class Geo, class Pulse>
+    void AddOnePhelKernel(std::vector<Float_t> &wave, const std::vector<Float_t> &times, const Double_t *pars, Double_t start);
+    /** @brief Gain, noise and feature extraction of @ref SaveEvent(), instantiated for a geometry. */
+    template<class Geo>
+    void DigitizeKernel();
+    /** @brief Selects the instantiations of the kernels for the geometry and the pulse model. */
+    void SelectKernels();
+    /** @brief Selects the instantiations of the kernels for a geometry and the current pulse model. */
+    template<class Geo>
+    void BindKernels();
+    /** @brief Selects the instantiations of the kernels for a geometry and a pulse model. */
+    template<class Geo, class Pulse>
+    void BindPulseKernels();
+
+    void (BarLYSO::*fAddOnePhelKernel)(std::vector<Float_t>&, const std::vector<Float_t>&, const Double_t*, Double_t) = nullptr; /**< @brief Selected instantiation of @ref AddOnePhelKernel() */
+    void (BarLYSO::*fDigitizeKernel)() = nullptr; /**< @brief Selected instantiation of @ref DigitizeKernel() */
+    Float_t (*fEvalPulse)(Float_t, const Double_t*, Double_t) = nullptr; /**< @brief Evaluator of the current pulse model, for the code outside the synthesis loops */
+    Double_t (*fPulseDuration)(const Double_t*) = nullptr; /**< @brief Longest time constant of the current pulse model */
+    void (*fSamplePulse)(TH3D*, const std::vector<Double_t>&, TRandom*, Double_t*) = nullptr; /**< @brief Sampling of the parameters of the current pulse model */
+
+    /**
+     * @brief Event of the free-running mode whose window is not saved yet.
+     */
+    struct FreeTrigger
+    {
+        Int_t fEvent; /**< @brief Event number */
+        Long64_t fStart; /**< @brief Global index of the first sample of the window */
+        std::vector<Int_t> fCh_F, fCh_B; /**< @brief Channels of the photons, for the truth of the features */
+        std::vector<Double_t> fT_F, fT_B; /**< @brief Arrival times of the photons, for the truth of the features */
+    };
+    Double_t fFreeRate = 0; /**< @brief Event rate [MHz] of the free-running mode (0 disables it) */
+    Double_t fFreeTime = 0; /**< @brief Arrival time [ns] of the last event on the global timeline */
+    Long64_t fFreePileUps = 0; /**< @brief Events arrived within a window length of the previous one */
+    Long64_t fRingStart = 0; /**< @brief Global index of the oldest sample kept in the ring buffers */
+    Long64_t fRingMask = 0; /**< @brief Capacity of the ring buffers minus one (the capacity is a power of 2) */
+    std::vector<std::vector<Float_t>> fRing_F; /**< @brief Noiseless ring buffers of the Front-Detector, one per channel */
+    std::vector<std::vector<Float_t>> fRing_B; /**< @brief Noiseless ring buffers of the Back-Detector, one per channel */
+    std::deque<FreeTrigger> fTriggers; /**< @brief Events whose window can still receive photons */
+    /** @brief Synthesizes the photons of one detector of an event arrived at arrival [ns] into the ring buffers. */
+    void DepositFreeRunning(Bool_t isFront, Double_t arrival, Int_t nHits, const Int_t *channels, const Double_t *starts);
+    /** @brief Extracts, digitizes and saves the window of an event. */
+    void SaveFreeRunningWindow(const FreeTrigger &trigger);
+    /** @brief Saves the windows ending before the given global sample and drops the samples no window needs. */
+    void ReleaseFreeRunning(Long64_t untilSample);
+    /** @brief Enlarges the ring buffers to hold at least the given number of samples. */
+    void GrowRing(Long64_t samples);
+    /** @brief Sums a 1-Phel waveform to a ring buffer, from the global sample first, instantiated for a pulse model. */
+    template<class Pulse>
+    void AddRingPulseKernel(std::vector<Float_t> &ring, Long64_t first, Int_t nSamples, Double_t firstTime, const Double_t *pars);
+    void (BarLYSO::*fAddRingPulseKernel)(std::vector<Float_t>&, Long64_t, Int_t, Double_t, const Double_t*) = nullptr; /**< @brief Selected instantiation of @ref AddRingPulseKernel() */
+
+    Int_t fApproxThreshold = 0; /**< @brief Number of photons in a channel above which the waveform is approximated (0 disables the approximation) */
+    Double_t fApproxStep = 0; /**< @brief Lag step [ns] of the tabulated mean pulse */
+    std::vector<Float_t> fApproxMean; /**< @brief Mean 1-Phel waveform as a function of the lag from the photon arrival */
+    std::vector<Float_t> fApproxVar; /**< @brief Variance of the 1-Phel waveform as a function of the lag from the photon arrival */
+    /**
+     * @brief Tabulates @ref fApproxMean and @ref fApproxVar by sampling the
+     * parameters of the pulse model with a generator of fixed seed. Called by
+     * @ref SetParsDistro() when the approximation is enabled.
+     */
+    void BuildApproxPulse();
+    /**
+     * @brief Sums to a waveform the approximated contribution of many
+     * photons.
+     *
+     * The arrival times are histogrammed with a bin width of @ref fApproxStep
+     * and convolved with the mean 1-Phel waveform; each sample is then
+     * smeared with a gaussian whose variance is the convolution of the
+     * histogram with the variance of the 1-Phel waveform, i.e. the spread due
+     * to the fluctuations of \f$(A, \tau_{RISE}, \tau_{DEC})\f$. The
+     * correlations between samples are neglected.
+     */
+    void AddApproxChannel(std::vector<Float_t> &wave, const std::vector<Float_t> &times, std::vector<Double_t> &starts);
+    /** @brief Common implementation of @ref SetFrontWaveforms() and @ref SetBackWaveforms(). */
+    void SetWaveforms(Bool_t isFront, Int_t nHits, const Int_t *channels, const Double_t *starts);
+
+    Resampler *fResampler = nullptr; /**< @brief Conversion from the synthesis grid to the sampling speed, if the synthesis rate is set */
+    std::vector<Float_t> fFineTimes; /**< @brief Times of the synthesis grid, shared by all the channels */
+    std::vector<std::vector<Float_t>> fFine_F; /**< @brief Front-Detector waveforms on the synthesis grid */
+    std::vector<std::vector<Float_t>> fFine_B; /**< @brief Back-Detector waveforms on the synthesis grid */
+    std::vector<Char_t> fIsFineUsed_F; /**< @brief Whether a channel of @ref fFine_F received photons in the current event */
+    std::vector<Char_t> fIsFineUsed_B; /**< @brief Whether a channel of @ref fFine_B received photons in the current event */
+    /**
+     * @brief Sets up @ref fResampler and the synthesis grid, if the synthesis
+     * rate is set. Called by @ref SetSamplingTimes().
+     */
+    void InitResampler();
+    /**
+     * @brief Converts the waveforms of a detector from the synthesis grid to
+     * the sampling times, then clears the grid.
+     */
+    void ResampleWaveforms(Bool_t isFront);
+    /**
+     * @brief Marks a channel as receiving a signal in the current event,
+     * zeroing its waveform the first time: the inactive channels are not
+     * reset between events.
+     */
+    inline void ActivateChannel(Bool_t isFront, Int_t channel)
+    {
+        std::vector<Char_t> &active = isFront ? fActive_F : fActive_B;
+        if(active[channel])
+            return;
+        std::vector<Float_t> &wave = isFront ? fFront[channel] : fBack[channel];
+        std::fill(wave.begin(), wave.end(), 0.f);
+        active[channel] = true;
+    }
+    /** @brief Sums a 1-Phel waveform to a channel of the Front-Detector, on the synthesis grid if set. */
+    inline void AddFrontPhel(Int_t channel, const Double_t *pars, Double_t start)
+    {
+        ActivateChannel(true, channel);
+        if(fResampler)
+        {
+            AddOnePhel(fFine_F[channel], fFineTimes, pars, start);
+            fIsFineUsed_F[channel] = true;
+        }
+        else
+            AddOnePhel(fFront[channel], GetChannelTimes(true, channel), pars, start);
+    }
+    /** @brief Sums a 1-Phel waveform to a channel of the Back-Detector, on the synthesis grid if set. */
+    inline void AddBackPhel(Int_t channel, const Double_t *pars, Double_t start)
+    {
+        ActivateChannel(false, channel);
+        if(fResampler)
+        {
+            AddOnePhel(fFine_B[channel], fFineTimes, pars, start);
+            fIsFineUsed_B[channel] = true;
+        }
+        else
+            AddOnePhel(fBack[channel], GetChannelTimes(false, channel), pars, start);
+    }
+    std::vector<std::vector<Double_t>> fApproxStarts; /**< @brief Arrival times of the photons of the approximated channels */
+
+    SiPMNoise fSiPMNoise; /**< @brief Noise of the SiPM type, added to the photons of each event */
+    std::vector<std::vector<Double_t>> fAvalanches; /**< @brief Start times of the avalanches of each channel, photons first, then the noise pulses */
+    std::vector<Double_t> fNoisePars; /**< @brief Pulse parameters of the noise pulses of a channel, @ref MAX_PULSE_PARS each */
+    /**
+     * @brief Adds the noise pulses of the SiPMs of a detector to the current
+     * event.
+     *
+     * @ref fAvalanches holds the photons of each channel, filled by the
+     * caller. Per channel, the numbers of dark counts (uniform in the window
+     * and in a margin before it), crosstalk pulses (at the time of a random
+     * avalanche) and afterpulses (delayed from a random avalanche) are each
+     * a single Poisson draw. The noise pulses are then approximated above
+     * @ref fApproxThreshold, otherwise sorted and summed in one pass with
+     * @ref AddNoiseKernel() (one by one in reference mode). @ref fAvalanches
+     * is cleared.
+     */
+    void AddSiPMNoise(Bool_t isFront);
+    /**
+     * @brief Sums the noise pulses of a channel, sorted by start time, each
+     * evaluated only from its start to a fixed number of its longest time
+     * constant. Instantiated for a pulse model.
+     */
+    template<class Pulse>
+    void AddNoiseKernel(std::vector<Float_t> &wave, const std::vector<Float_t> &times, const Double_t *starts, const Double_t *pars, Int_t nPulses);
+    void (BarLYSO::*fAddNoiseKernel)(std::vector<Float_t>&, const std::vector<Float_t>&, const Double_t*, const Double_t*, Int_t) = nullptr; /**< @brief Selected instantiation of @ref AddNoiseKernel() */
+    /**
+     * @brief Returns whether a channel index of the input is within the
+     * detector. The photons of the other channels are skipped, with a
+     * warning the first time (see @ref WarnChannel()).
+     */
+    inline Bool_t IsValidChannel(Int_t channel) { return (channel >= 0 && channel < fChannels) || WarnChannel(channel); }
+    /** @brief Warns once about a channel index out of the detector, and returns false. */
+    Bool_t WarnChannel(Int_t channel);
+
+    Bool_t fIsChannelWarned = false; /**< @brief Whether a channel index out of the detector was already reported */
+    Bool_t fIsRecordingPhotons = false; /**< @brief Whether to record the photons of each event */
+    Bool_t fIsReference = false; /**< @brief Whether to use only the plain scalar synthesis, as reference for the faster paths */
+    std::vector<Photon> fPhotons_F; /**< @brief Photons of the Front-Detector in the current event, if recorded */
+    std::vector<Photon> fPhotons_B; /**< @brief Photons of the Back-Detector in the current event, if recorded */
 
 };
 
@@ -0,0 +1,50 @@
+/**
+ * @file calibration.hh
+ * @brief Definition of the struct ChannelCalibration and declaration of the
+ * function @ref LoadCalibrationTable()
+ */
+#ifndef CALIBRATION_HH
+#define CALIBRATION_HH
+
+#include <string>
+#include <vector>
+
+#include <Rtypes.h>
+
+/**
+ * @brief Struct for storing the DAQ response of one channel, as applied by
+ * the digitization.
+ */
+struct ChannelCalibration
+{
+    Float_t fFactor; /**< @brief Factor of gain conversion from the template gain (0 for a dead channel) */
+    Float_t fBaseline; /**< @brief Baseline [V] */
+    Float_t fSigmaNoise; /**< @brief Noise [V] (enlarged for a hot channel) */
+};
+
+
+/**
+ * @brief Reads a per-channel calibration table.
+ *
+ * The text file has one line per channel,
+ *
+ *     # Side Channel Gain[dB] Baseline[V] Sigma[V] Flag
+ *     F 0 28.0 0.45 0.005 ok
+ *     B 12 27.5 0.44 0.006 dead
+ *
+ * with Side F or B and Flag ok, dead (no signal, only the noise) or hot
+ * (noise enlarged by @ref HOT_NOISE_FACTOR). Lines starting with # are
+ * skipped; the channels not listed keep the given defaults.
+ *
+ * @param gainTemplate Gain [dB] of the template data
+ * @param defaults Response of the channels not listed
+ * @param front, back Filled with one entry per channel
+ * @return Number of channels read, or -1 if the file can't be read or has
+ * an invalid line
+ */
+Int_t LoadCalibrationTable(const std::string &filename, Int_t channels, Float_t gainTemplate, const ChannelCalibration &defaults, std::vector<ChannelCalibration> &front, std::vector<ChannelCalibration> &back);
+
+constexpr Float_t HOT_NOISE_FACTOR = 10; /**< @brief Noise of a hot channel, in units of its sigma */
+
+
+#endif  // CALIBRATION_HH
@@ -1,6 +1,6 @@
 /**
  * @file configure.hh
- * @brief Declaration of the function @ref Bartender_Configure() (and the
+ * @brief Declaration of the functions @ref Bartender_Configure() (and the
  * auxiliary function @ref extract_value())
  */
 #ifndef CONFIGURE_HH
@@ -12,9 +12,11 @@
 #include <string>
 #include <cfloat>
 #include <regex>
+#include <vector>
 
 #include "bar.hh"
 #include "SiPM.hh"
+#include "settings.hh"
 
 /**
  * @brief Extracts a value from a line using a specific keyword.
@@ -42,4 +44,28 @@ std::string extract_value(const std::string& line, const std::string& keyword);
 void Bartender_Configure(const char* filename, BarLYSO* bar, SiPM* sipm);
 
 
+/**
+ * @brief Populates the members of the BarLYSO class from a struct instead of a
+ * mac file.
+ *
+ * Meant for programs that embed the synthesis (e.g. the MC or a Python
+ * session) and don't want to write a mac file.
+ *
+ * @param settings The settings to apply
+ * @param bar BarLYSO class pointer 
+ */
+void Bartender_Configure(const BarSettings& settings, BarLYSO* bar);
+
+
+/**
+ * @brief Overrides the selection of channels and events of the mac with the
+ * command-line options.
+ *
+ * @param options Pairs of option (--channels-F, --channels-B, --hits-F,
+ * --hits-B) and value (list of channels, or "min max")
+ * @param bar BarLYSO class pointer
+ */
+void Bartender_ApplyFilterOptions(const std::vector<std::pair<std::string, std::string>> &options, BarLYSO* bar);
+
+
 #endif  // CONFIGURE_HH
\ No newline at end of file
@@ -5,6 +5,8 @@
 #ifndef DAQ_HH
 #define DAQ_HH
 
+#include <cfloat>
+
 #include <TMath.h>
 #include <TRandom3.h>
 
@@ -17,8 +19,10 @@ class DAQ
     // Sampling
     Float_t fSamplingSpeed; /**< @brief Sampling speed [GSPS] of the DAQ */
     Float_t fSamplingSpeed_Template;
+    Float_t fSamplingSpeed_Synthesis = 0; /**< @brief Rate [GSPS] of the grid of the synthesis, resampled to @ref fSamplingSpeed (0 = synthesis at the sampling times, < 0 = @ref fSamplingSpeed_Template) */
     Bool_t fIsBinSizeConstant;
     Float_t fSigmaBinSize;
+    Int_t fJitterPool = 0; /**< @brief Jittered grids drawn once and assigned to the channels event by event (0 = one grid for the whole run) */
     TRandom3 *binRand;
     
     // Amplification
@@ -31,6 +35,9 @@ class DAQ
     Double_t fTau_shaping;
     Double_t fR_shaper_Template; /**< @brief Value [Ohm] of the resistance of the shaper */
     Float_t fSigmaNoise; /**< @brief Noise of the DAQ, evaluated as the stDev of the pedestal distribution */
+
+    // Digitization
+    Float_t fADCRange[2] = {-FLT_MAX, FLT_MAX}; /**< @brief Clipping levels [V] of the ADC: min, max */
 };
 
 
@@ -0,0 +1,107 @@
+/**
+ * @file eventloop.hh
+ * @brief Declaration of the reader of the MC input and of the event loop,
+ * shared by the single runs and the daemon mode
+ */
+#ifndef EVENTLOOP_HH
+#define EVENTLOOP_HH
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include "bar.hh"
+#include "overlay.hh"
+#include "photoncache.hh"
+
+/**
+ * @brief Reads the "lyso" TTree of a MC file, with only the branches used by
+ * the synthesis enabled.
+ */
+class McInput
+{
+public:
+    McInput() = default;
+    ~McInput() { Close(); }
+
+    McInput(const McInput&) = delete;
+    McInput &operator=(const McInput&) = delete;
+
+    /**
+     * @brief Opens the MC file and attaches the branches.
+     *
+     * @return false if the file or the tree can't be read
+     */
+    Bool_t Open(const char *filename);
+    /** @brief Detaches the branches and closes the file. */
+    void Close();
+
+    inline Long64_t GetEntries() const { return fTree ? fTree->GetEntries() : 0; } /**< @brief Returns the number of MC events. */
+    /** @brief Reads an entry into the public members. */
+    inline void GetEntry(Long64_t entry) { fTree->GetEntry(entry); }
+    /** @brief Reads only the numbers of hits of an entry, to select it before @ref GetEntry(). */
+    inline void GetHits(Long64_t entry)
+    {
+        fBranchNHits_F->GetEntry(entry);
+        fBranchNHits_B->GetEntry(entry);
+    }
+
+    Int_t fEvent = 0; /**< @brief Event number */
+    Int_t fNHits_F = 0; /**< @brief Photons of the Front-Detector */
+    Int_t fNHits_B = 0; /**< @brief Photons of the Back-Detector */
+    std::vector<Double_t> *fT_F = nullptr; /**< @brief Arrival times of the photons of the Front-Detector */
+    std::vector<Double_t> *fT_B = nullptr; /**< @brief Arrival times of the photons of the Back-Detector */
+    std::vector<Int_t> *fCh_F = nullptr; /**< @brief Channels of the photons of the Front-Detector */
+    std::vector<Int_t> *fCh_B = nullptr; /**< @brief Channels of the photons of the Back-Detector */
+
+private:
+    std::unique_ptr<TFile> fFile;
+    TTree *fTree = nullptr;
+    TBranch *fBranchNHits_F = nullptr;
+    TBranch *fBranchNHits_B = nullptr;
+};
+
+
+/**
+ * @brief Additional DAQ configuration fed with the events of the main
+ * generator (--sweep).
+ */
+struct SweepTarget
+{
+    BarLYSO *fBar; /**< @brief Generator of the configuration */
+    Bool_t fIsSharingWaveforms; /**< @brief Whether it copies the waveforms instead of synthesizing the photons again */
+};
+
+
+/**
+ * @brief Synthesizes and saves the MC entries [first, last).
+ *
+ * The output of bar (and of the sweeps) must be open, with the sampling
+ * times set. In free-running mode the pending windows are saved at the end.
+ * The events rejected by the filter of bar are skipped, for the sweeps too,
+ * after reading only their numbers of hits.
+ *
+ * @param sweeps Sweep configurations, each saving the entries after its own
+ * resume entry
+ * @param overlay If not null, the noiseless waveforms are appended to this
+ * background library instead of being saved
+ * @param prefix Prefix of the progress lines (empty for no progress)
+ */
+void Bartender_Loop(BarLYSO *bar, McInput &mc, Long64_t first, Long64_t last, const std::vector<SweepTarget> &sweeps, OverlayWriter *overlay, const std::string &prefix);
+
+/**
+ * @brief Digitizes again the events [first, last) of a photon-level cache,
+ * without reading the MC file.
+ *
+ * The output of bar must be open, with the sampling times set. The stored
+ * pulse parameters are used if bar has the same pulse model.
+ *
+ * @param prefix Prefix of the progress lines (empty for no progress)
+ */
+void Bartender_Replay(BarLYSO *bar, PhotonCache &cache, Long64_t first, Long64_t last, const std::string &prefix);
+
+
+#endif  // EVENTLOOP_HH
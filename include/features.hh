@@ -0,0 +1,85 @@
+/**
+ * @file features.hh
+ * @brief Declaration of the structs FeatureSettings and SideFeatures, and of
+ * the function @ref ExtractFeatures()
+ */
+#ifndef FEATURES_HH
+#define FEATURES_HH
+
+#include <vector>
+#include <cfloat>
+
+#include <Rtypes.h>
+
+/**
+ * @brief Struct for storing the settings of the inline feature extraction.
+ */
+struct FeatureSettings
+{
+    Bool_t fIsEnabled = false; /**< @brief Whether to write the lyso_features tree */
+    Int_t fBaselineSamples = 100; /**< @brief Number of samples at the beginning of the window used to evaluate the baseline */
+    Float_t fCFFraction = 0.2; /**< @brief Fraction of the amplitude for the constant-fraction time */
+};
+
+
+/**
+ * @brief Struct for storing the per-channel estimators and truth information
+ * of one detector (Front or Back) for the current event.
+ */
+struct SideFeatures
+{
+    std::vector<Float_t> fBaseline; /**< @brief Mean of the first @ref FeatureSettings::fBaselineSamples samples [V] */
+    std::vector<Float_t> fAmplitude; /**< @brief Baseline minus the minimum of the waveform [V] */
+    std::vector<Float_t> fCharge; /**< @brief Integral of the baseline-subtracted (inverted) waveform [V ns] */
+    std::vector<Float_t> fPeakTime; /**< @brief Time of the minimum of the waveform [ns] */
+    std::vector<Float_t> fCFTime; /**< @brief Constant-fraction time on the leading edge [ns] */
+    std::vector<Int_t> fNPhotons; /**< @brief MC truth: number of photons detected by the channel */
+    std::vector<Float_t> fFirstTime; /**< @brief MC truth: arrival time of the first photon [ns] (FLT_MAX if none) */
+
+    /** @brief Sets the number of channels of all the containers. */
+    inline void Resize(Int_t channels)
+    {
+        for(auto *v : {&fBaseline, &fAmplitude, &fCharge, &fPeakTime, &fCFTime, &fFirstTime})
+            v->assign(channels, 0.);
+        fNPhotons.assign(channels, 0);
+    }
+    /** @brief Zeroes the estimators of a channel that is not digitized. */
+    inline void ClearEstimators(Int_t channel)
+    {
+        for(auto *v : {&fBaseline, &fAmplitude, &fCharge, &fPeakTime, &fCFTime})
+            (*v)[channel] = 0;
+    }
+    /** @brief Clears the truth information before a new event. */
+    inline void ResetTruth()
+    {
+        fNPhotons.assign(fNPhotons.size(), 0);
+        fFirstTime.assign(fFirstTime.size(), FLT_MAX);
+    }
+    /** @brief Records the truth information of a photon. */
+    inline void AddPhoton(Int_t channel, Float_t time)
+    {
+        fNPhotons[channel]++;
+        if(time < fFirstTime[channel]) fFirstTime[channel] = time;
+    }
+};
+
+
+/**
+ * @brief Computes the estimators of one digitized waveform.
+ *
+ * The waveform is negative-going with respect to the baseline: the amplitude
+ * and the charge are returned as positive numbers. The constant-fraction time
+ * is linearly interpolated between the two samples crossing the threshold on
+ * the leading edge of the pulse.
+ *
+ * @param wave Samples of the waveform [V]
+ * @param times Sampling times of the waveform [ns]
+ * @param n Number of samples
+ * @param settings Settings of the extraction
+ * @param features Containers of the detector
+ * @param channel Channel index in the containers
+ */
+void ExtractFeatures(const Float_t *wave, const Float_t *times, Int_t n, const FeatureSettings &settings, SideFeatures &features, Int_t channel);
+
+
+#endif  // FEATURES_HH
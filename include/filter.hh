@@ -0,0 +1,54 @@
+/**
+ * @file filter.hh
+ * @brief Definition of the struct EventFilter and declaration of the function
+ * @ref ParseChannelList()
+ */
+#ifndef FILTER_HH
+#define FILTER_HH
+
+#include <string>
+#include <vector>
+
+#include <Rtypes.h>
+
+/**
+ * @brief Struct for storing the selection of the channels to synthesize and
+ * of the events to process.
+ *
+ * The events are selected on the numbers of hits only, which are read before
+ * the arrival times and the channels of the photons.
+ */
+struct EventFilter
+{
+    std::string fChannels_F = "all"; /**< @brief Channels of the Front-Detector to synthesize and store: "all" or a list of indices and ranges, e.g. "0-8 20" */
+    std::string fChannels_B = "all"; /**< @brief Channels of the Back-Detector to synthesize and store, as @ref fChannels_F */
+    Int_t fHits_F[2] = {0, -1}; /**< @brief Range of the hits of the Front-Detector of the events to process: min, max (< 0 for no limit) */
+    Int_t fHits_B[2] = {0, -1}; /**< @brief Range of the hits of the Back-Detector of the events to process: min, max (< 0 for no limit) */
+
+    /** @brief Returns whether some events can be skipped. */
+    inline Bool_t IsSelectingEvents() const
+    {
+        return fHits_F[0] > 0 || fHits_F[1] >= 0 || fHits_B[0] > 0 || fHits_B[1] >= 0;
+    }
+    /** @brief Returns whether an event with the given numbers of hits is to be processed. */
+    inline Bool_t IsSelected(Int_t nHits_F, Int_t nHits_B) const
+    {
+        return nHits_F >= fHits_F[0] && (fHits_F[1] < 0 || nHits_F <= fHits_F[1])
+            && nHits_B >= fHits_B[0] && (fHits_B[1] < 0 || nHits_B <= fHits_B[1]);
+    }
+};
+
+
+/**
+ * @brief Converts a list of channels into a mask.
+ *
+ * @param list "all", or indices and ranges (first-last) separated by spaces or
+ * commas
+ * @param channels Number of channels of the detector
+ * @param mask Filled with one flag per channel
+ * @return false if the list can't be parsed or is out of range
+ */
+Bool_t ParseChannelList(const std::string &list, Int_t channels, std::vector<Char_t> &mask);
+
+
+#endif  // FILTER_HH
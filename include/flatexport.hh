@@ -0,0 +1,91 @@
+/**
+ * @file flatexport.hh
+ * @brief Declaration of the class FlatExporter, the flat binary writer of the
+ * waveforms for numpy and other non-ROOT consumers
+ *
+ * The waveforms are written as raw little-endian float32 arrays with shape
+ * [events][2][channels][samplings] (side 0 = Front, 1 = Back), optionally
+ * split in chunks of a fixed number of events, and described by a JSON
+ * sidecar written at the end of the run:
+ * @code
+ * import json, numpy as np
+ * meta = json.load(open("BarID_1707049321.json"))
+ * for chunk in meta["chunks"]:
+ *     wfs = np.memmap(chunk["file"], dtype=meta["dtype"], mode="r",
+ *                     shape=(chunk["events"], 2, meta["channels"], meta["samplings"]))
+ * @endcode
+ * Like shmring.hh, it doesn't depend on ROOT.
+ */
+#ifndef FLATEXPORT_HH
+#define FLATEXPORT_HH
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Writes the waveforms of each event in flat binary files, plus the
+ * sampling times, the event numbers and the JSON sidecar.
+ */
+class FlatExporter
+{
+public:
+    FlatExporter() = default;
+    ~FlatExporter() { Close(); }
+
+    /**
+     * @brief Opens the first chunk.
+     *
+     * @param base Path of the files without extension: the chunks are
+     * base.bin (or base_0000.bin, base_0001.bin, ... if chunked), with
+     * base_times.bin, base_events.bin and the sidecar base.json
+     * @param chunkEvents Events per chunk (0 for a single file)
+     * @return false if the file can't be created
+     */
+    bool Open(const std::string &base, uint32_t channels, uint32_t samplings, int32_t mcid, uint64_t chunkEvents, float samplingSpeed, bool isBinSizeConstant);
+    /**
+     * @brief Writes the sampling times, [2][channels][samplings] float32.
+     */
+    void SetTimes(const std::vector<std::vector<float>> &times_F, const std::vector<std::vector<float>> &times_B);
+    /**
+     * @brief Appends an event, opening a new chunk if the current one is full.
+     *
+     * @return false on a write error
+     */
+    bool Write(int32_t event, const std::vector<std::vector<float>> &front, const std::vector<std::vector<float>> &back);
+    /**
+     * @brief Closes the last chunk and writes the event numbers and the JSON
+     * sidecar.
+     */
+    void Close();
+
+    inline uint64_t GetEntries() const { return fEvents.size(); } /**< @brief Returns the number of events written. */
+    inline uint64_t GetBytesWritten() const { return fBytes; } /**< @brief Returns the bytes of waveforms written. */
+
+private:
+    /** @brief Opens the next chunk file. */
+    bool OpenChunk();
+    /** @brief Writes n floats in little-endian order. */
+    void WriteFloats(std::ofstream &file, const float *values, size_t n);
+
+    std::string fBase;
+    uint32_t fChannels = 0;
+    uint32_t fSamplings = 0;
+    int32_t fMCID = 0;
+    uint64_t fChunkEvents = 0;
+    float fSamplingSpeed = 0;
+    bool fIsBinSizeConstant = true;
+    bool fIsOpen = false;
+    bool fIsClosed = false;
+
+    std::ofstream fChunk; /**< @brief Chunk being written */
+    std::vector<std::string> fChunkFiles; /**< @brief Names of the chunk files */
+    std::vector<uint64_t> fChunkSizes; /**< @brief Events in each chunk */
+    std::vector<int32_t> fEvents; /**< @brief Event number of each entry */
+    uint64_t fBytes = 0;
+    std::vector<char> fBuffer; /**< @brief Buffer of the chunk stream */
+};
+
+
+#endif  // FLATEXPORT_HH
@@ -6,10 +6,30 @@
 #define GLOBALS_HH
 
 
-constexpr Int_t CHANNELS = 115; /**< @brief Number of channels of the detectors */
-constexpr Int_t SAMPLINGS = 1024; /**< @brief Number of samplings for one waveform */
+constexpr Int_t CHANNELS = 115; /**< @brief Default number of channels of the detectors */
+constexpr Int_t SAMPLINGS = 1024; /**< @brief Default number of samplings for one waveform */
 constexpr Float_t BASELINE = 0.45;
 constexpr Float_t ZERO_TIME_BIN = 450.0; /**< @brief Delay of all waveforms in the [0, 1023] bins window */
 
 
+/**
+ * @brief Compile-time geometry of the detectors: channels per detector and
+ * samplings per waveform.
+ *
+ * The inner loops of BarLYSO are instantiated for a few common geometries
+ * (see BarLYSO::SetGeometry()) so that their bounds are compile-time
+ * constants. Geometry<0, 0> is the generic fallback, which takes the bounds at
+ * runtime.
+ */
+template<Int_t C, Int_t S>
+struct Geometry
+{
+    static constexpr Int_t kChannels = C; /**< @brief Channels per detector (0 if generic) */
+    static constexpr Int_t kSamplings = S; /**< @brief Samplings per waveform (0 if generic) */
+    static constexpr Bool_t kIsGeneric = (C == 0 || S == 0); /**< @brief Whether the bounds are known only at runtime */
+};
+
+using GenericGeometry = Geometry<0, 0>;
+
+
 #endif  // GLOBALS_HH
\ No newline at end of file
@@ -0,0 +1,43 @@
+/**
+ * @file output.hh
+ * @brief Definition of the struct OutputSettings
+ */
+#ifndef OUTPUT_HH
+#define OUTPUT_HH
+
+#include <map>
+#include <string>
+
+#include <Rtypes.h>
+
+/**
+ * @brief Struct for storing the settings of the output ROOT file.
+ */
+struct OutputSettings
+{
+    // Checkpointing
+    Long64_t fCheckpointEvents = 0; /**< @brief Number of events between two checkpoints of the output file (0 disables checkpointing) */
+
+    // Compression
+    std::string fCompressionAlgorithm; /**< @brief Compression algorithm of the output file: ZLIB, LZMA, LZ4 or ZSTD (empty for the ROOT default) */
+    Int_t fCompressionLevel = -1; /**< @brief Compression level [0-9] of the output file (-1 for the ROOT default) */
+
+    // Baskets and clusters
+    std::map<std::string, Int_t> fBasketSizes; /**< @brief Basket size [bytes] for each branch of the output trees; the key "*" applies to all branches */
+    Long64_t fAutoFlush = 0; /**< @brief Auto-flush threshold of the output trees: entries if positive, bytes if negative, ROOT default if 0 */
+    Long64_t fAutoSave = 0; /**< @brief Auto-save threshold of the output trees: entries if positive, bytes if negative, ROOT default if 0 */
+    Long64_t fMemoryCap = 0; /**< @brief Maximum memory [bytes] held by the baskets of the waveform tree (0 for no limit); it also bounds fAutoFlush, in bytes or in entries of uncompressed events */
+
+    // Sink of the waveforms
+    std::string fSink = "file"; /**< @brief Where the waveforms go: "file" (lyso_wfs tree), "rntuple" (lyso_wfs RNTuple, see RNTupleSink), "binary" (flat float32 files, see FlatExporter) or "shm" (shared-memory ring, see ShmProducer) */
+    std::string fShmName; /**< @brief Name of the shared-memory segment (empty to derive it from the output filename) */
+    Int_t fShmSlots = 8; /**< @brief Number of events the shared-memory ring can hold */
+    Int_t fShmTimeout = 1000; /**< @brief Time [ms] to wait for a free slot before writing the event to the file instead */
+    Long64_t fFlatChunkEvents = 0; /**< @brief Events per file of the "binary" sink (0 for a single file) */
+
+    // Photon-level cache
+    Bool_t fIsSavingPhotons = false; /**< @brief Whether to save the photons with their pulse parameters in the lyso_photons tree (see photoncache.hh) */
+};
+
+
+#endif  // OUTPUT_HH
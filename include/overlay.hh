@@ -0,0 +1,128 @@
+/**
+ * @file overlay.hh
+ * @brief Declaration of the classes OverlayWriter and OverlayLibrary, the two
+ * ends of the library of background waveforms mixed into the signal events
+ *
+ * A library is built once from a background MC run, with the waveforms still
+ * noiseless and before the gain, and can then be overlaid on any number of
+ * signal runs with the same geometry and sampling speed:
+ * @code
+ * ./bartender_lyso MCID_bkg.root SiPM.mac --build-overlay bkg.ovl
+ * @endcode
+ * The file starts with an @ref OverlayHeader, followed by the events. Every
+ * event holds the scales of its 2*channels waveforms (float32, Front first)
+ * and their samples as int16, [2][channels][samplings]: the stored value
+ * times the scale of the waveform is the amplitude. The library is mapped in
+ * memory, so the pages are shared by the processes reading it and loaded on
+ * demand. Like shmring.hh, it doesn't depend on ROOT.
+ */
+#ifndef OVERLAY_HH
+#define OVERLAY_HH
+
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Header at the beginning of a library file, in the byte order of the
+ * host that wrote it (checked through @ref fMagic).
+ */
+struct OverlayHeader
+{
+    char fMagic[8]; /**< @brief "BAROVL01" */
+    uint32_t fEndianness; /**< @brief 0x01020304 as written by the host */
+    uint32_t fChannels; /**< @brief Number of channels per detector */
+    uint32_t fSamplings; /**< @brief Number of samplings per waveform */
+    float fSamplingSpeed; /**< @brief Sampling speed [GSa/s] */
+    uint64_t fEvents; /**< @brief Number of events in the library */
+    uint64_t fReserved[4];
+};
+
+
+/**
+ * @brief Appends the noiseless waveforms of the background events to a
+ * library file.
+ */
+class OverlayWriter
+{
+public:
+    OverlayWriter() = default;
+    ~OverlayWriter() { Close(); }
+
+    /**
+     * @brief Creates the library file.
+     *
+     * @return false if the file can't be created
+     */
+    bool Open(const std::string &filename, uint32_t channels, uint32_t samplings, float samplingSpeed);
+    /**
+     * @brief Quantizes and appends an event. The channels without a signal
+     * (false in active_F or active_B) and the masked ones are stored as zeros.
+     *
+     * @return false on a write error
+     */
+    bool Write(const std::vector<std::vector<float>> &front, const std::vector<std::vector<float>> &back, const std::vector<char> &active_F, const std::vector<char> &active_B);
+    /**
+     * @brief Writes the final number of events in the header and closes the
+     * file.
+     */
+    void Close();
+
+    inline uint64_t GetEntries() const { return fHeader.fEvents; } /**< @brief Returns the number of events written. */
+
+private:
+    std::ofstream fFile;
+    OverlayHeader fHeader = {};
+    std::vector<float> fScales; /**< @brief Scales of the event being written */
+    std::vector<int16_t> fSamples; /**< @brief Quantized samples of the event being written */
+};
+
+
+/**
+ * @brief Read-only view of a library file mapped in memory.
+ */
+class OverlayLibrary
+{
+public:
+    OverlayLibrary() = default;
+    ~OverlayLibrary() { Close(); }
+
+    OverlayLibrary(const OverlayLibrary&) = delete;
+    OverlayLibrary &operator=(const OverlayLibrary&) = delete;
+
+    /**
+     * @brief Maps the library.
+     *
+     * @return false if the file can't be read or is not a valid library
+     */
+    bool Open(const std::string &filename);
+    /** @brief Unmaps the library. */
+    void Close();
+
+    /**
+     * @brief Sums a waveform of the library, delayed by shift samples
+     * (advanced if negative), to the samplings of wave.
+     *
+     * The samples shifted outside the window are dropped.
+     *
+     * @param side 0 for the Front-Detector, 1 for the Back-Detector
+     */
+    void AddShifted(uint64_t event, int side, uint32_t channel, int32_t shift, float *wave) const;
+
+    inline bool IsOpen() const { return fBase != nullptr; } /**< @brief Returns whether a library is mapped. */
+    inline uint64_t GetEvents() const { return fHeader.fEvents; } /**< @brief Returns the number of events of the library. */
+    inline uint32_t GetChannels() const { return fHeader.fChannels; } /**< @brief Returns the channels per detector of the library. */
+    inline uint32_t GetSamplings() const { return fHeader.fSamplings; } /**< @brief Returns the samplings per waveform of the library. */
+    inline float GetSamplingSpeed() const { return fHeader.fSamplingSpeed; } /**< @brief Returns the sampling speed [GSa/s] of the library. */
+
+private:
+    OverlayHeader fHeader = {};
+    void *fBase = nullptr; /**< @brief Beginning of the mapping */
+    size_t fSize = 0; /**< @brief Size of the mapping [bytes] */
+    size_t fEventSize = 0; /**< @brief Size of an event [bytes] */
+};
+
+
+#endif  // OVERLAY_HH
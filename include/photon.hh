@@ -0,0 +1,24 @@
+/**
+ * @file photon.hh
+ * @brief Definition of the struct Photon
+ */
+#ifndef PHOTON_HH
+#define PHOTON_HH
+
+#include <Rtypes.h>
+
+#include "pulse.hh"
+
+/**
+ * @brief Struct for storing a detected photon together with the sampled
+ * parameters of its 1-Phel waveform.
+ */
+struct Photon
+{
+    Int_t fChannel; /**< @brief Channel index */
+    Double_t fTime; /**< @brief Arrival time [ns] from the MC */
+    Float_t fPars[MAX_PULSE_PARS]; /**< @brief Sampled parameters of the pulse model (see pulse.hh) */
+};
+
+
+#endif  // PHOTON_HH
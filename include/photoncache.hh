@@ -0,0 +1,91 @@
+/**
+ * @file photoncache.hh
+ * @brief Declaration of the photon-level cache: the columns of the
+ * lyso_photons tree and its reader for the replay mode
+ *
+ * With *Save photons = true* the output file gets a lyso_photons tree with,
+ * for each event and detector, the channel, the arrival time and the sampled
+ * pulse parameters of every photon, sorted by channel and time:
+ * @code
+ * Event, Ch_F, T_F, Pars_F, Ch_B, T_B, Pars_B
+ * @endcode
+ * Pars_X holds NPulsePars values per photon, in the columns of the pulse
+ * model saved as PulseModel (see pulse.hh). A run with --replay reads this
+ * tree instead of the MC one and only redoes the DAQ side.
+ */
+#ifndef PHOTONCACHE_HH
+#define PHOTONCACHE_HH
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include "photon.hh"
+
+/**
+ * @brief Columns of the photons of one detector in an event, as stored in the
+ * lyso_photons tree.
+ */
+struct PhotonColumns
+{
+    std::vector<Short_t> fChannel; /**< @brief Channel of each photon */
+    std::vector<Double_t> fTime; /**< @brief Arrival time [ns] of each photon */
+    std::vector<Float_t> fPars; /**< @brief Pulse parameters, nPars per photon */
+
+    /**
+     * @brief Fills the columns from the photons, sorted by channel and time.
+     */
+    void Pack(const std::vector<Photon> &photons, Int_t nPars);
+    /**
+     * @brief Rebuilds the photons from the columns.
+     */
+    void Unpack(std::vector<Photon> &photons, Int_t nPars) const;
+};
+
+
+/**
+ * @brief Reads the lyso_photons tree of a previous run.
+ */
+class PhotonCache
+{
+public:
+    PhotonCache() = default;
+    ~PhotonCache() { Close(); }
+
+    PhotonCache(const PhotonCache&) = delete;
+    PhotonCache &operator=(const PhotonCache&) = delete;
+
+    /**
+     * @brief Opens the output file of a run with *Save photons = true*.
+     *
+     * @return false if the file or the tree can't be read
+     */
+    Bool_t Open(const char *filename);
+    /** @brief Detaches the branches and closes the file. */
+    void Close();
+
+    inline Long64_t GetEntries() const { return fTree ? fTree->GetEntries() : 0; } /**< @brief Returns the number of events. */
+    inline const std::string &GetPulseModel() const { return fPulseModel; } /**< @brief Returns the pulse model of the stored parameters. */
+    /** @brief Reads an entry: the event number goes to @ref fEvent. */
+    void GetEntry(Long64_t entry, std::vector<Photon> &photons_F, std::vector<Photon> &photons_B);
+
+    Int_t fEvent = 0; /**< @brief Event number of the last entry read */
+
+private:
+    std::unique_ptr<TFile> fFile;
+    TTree *fTree = nullptr;
+    std::string fPulseModel;
+    Int_t fNPars = 0;
+    PhotonColumns fColumns_F;
+    PhotonColumns fColumns_B;
+    // Branch addresses: a pointer to each vector of the columns
+    std::vector<Short_t> *fChannel_F = &fColumns_F.fChannel, *fChannel_B = &fColumns_B.fChannel;
+    std::vector<Double_t> *fTime_F = &fColumns_F.fTime, *fTime_B = &fColumns_B.fTime;
+    std::vector<Float_t> *fPars_F = &fColumns_F.fPars, *fPars_B = &fColumns_B.fPars;
+};
+
+
+#endif  // PHOTONCACHE_HH
@@ -0,0 +1,149 @@
+/**
+ * @file pulse.hh
+ * @brief Definition of the models of the 1-Phel waveform
+ */
+#ifndef PULSE_HH
+#define PULSE_HH
+
+#include <algorithm>
+#include <vector>
+
+#include <TH3D.h>
+#include <TMath.h>
+#include <TRandom.h>
+
+constexpr Int_t MAX_PULSE_PARS = 5; /**< @brief Maximum number of parameters of a pulse model */
+
+
+/**
+ * @brief Copies a random row of the accepted rows of the parameters file,
+ * [row][nPars] flattened, to p.
+ */
+template<Int_t nPars>
+inline void SamplePulseRow(const std::vector<Double_t> &rows, TRandom *rand, Double_t *p)
+{
+    Int_t row = rand->Integer(rows.size() / nPars);
+    std::copy_n(rows.begin() + row * nPars, nPars, p);
+}
+
+
+/**
+ * @brief Two-exponential 1-Phel waveform (the default model).
+ *
+ * \f[
+ * \text{wave}(t) = -A \Bigg( \exp \Bigg( -\frac{t - t_{phel}}{\tau_{\text{RISE}}} \Bigg) - \exp \Bigg( -\frac{t - t_{phel}}{\tau_{\text{DEC}}} \Bigg) \Bigg)  \theta( t - t_{phel} )
+ * \f]
+ *
+ * Every model is a policy with the same interface: its name in the mac, the
+ * number of parameters and the columns of the parameters file where they are
+ * read, the sampling of the parameters, an evaluator inlined in the synthesis
+ * loops and the time scale after which the waveform is negligible.
+ */
+struct TwoExpPulse
+{
+    static constexpr const char *kName = "2exp"; /**< @brief Name of the model in the mac */
+    static constexpr Int_t kNPars = 3; /**< @brief Number of parameters */
+    static constexpr const char *kColumns[kNPars] = {"A", "Tau_rise", "Tau_fall"}; /**< @brief Columns of the parameters file */
+
+    /** @brief Samples the parameters from the 3D histogram of the parameters file. */
+    static inline void Sample(TH3D *histo, const std::vector<Double_t>&, TRandom *rand, Double_t *p)
+    {
+        histo->GetRandom3(p[0], p[1], p[2], rand);
+    }
+
+    /** @brief Value at t of the waveform with parameters p, starting at timePhel. */
+    static inline Float_t Eval(Float_t t, const Double_t *p, Double_t timePhel)
+    {
+        Double_t expRise = TMath::Exp(-(t-timePhel)/p[1]);
+        Double_t expDec = TMath::Exp(-(t-timePhel)/p[2]);
+
+        Float_t funcVal = static_cast<Float_t>(p[0]*(expRise-expDec)*((t > timePhel) ? 1:0));
+
+        // Numerical fixing
+        if(funcVal > 0 || TMath::IsNaN(funcVal)) funcVal = 0;
+        return funcVal;
+    }
+    /** @brief Longest time constant [ns] of the waveform. */
+    static inline Double_t Duration(const Double_t *p) { return TMath::Max(p[1], p[2]); }
+};
+
+
+/**
+ * @brief Three-exponential 1-Phel waveform, with a slow component of the
+ * decay.
+ *
+ * \f[
+ * \text{wave}(t) = -A \Big( e^{-\Delta t/\tau_{\text{RISE}}} - (1-R)\, e^{-\Delta t/\tau_{\text{DEC}}} - R\, e^{-\Delta t/\tau_{\text{SLOW}}} \Big) \theta(\Delta t)
+ * \f]
+ * with \f$ \Delta t = t - t_{phel} \f$ and R the fraction of the slow
+ * component.
+ */
+struct ThreeExpPulse
+{
+    static constexpr const char *kName = "3exp"; /**< @brief Name of the model in the mac */
+    static constexpr Int_t kNPars = 5; /**< @brief Number of parameters */
+    static constexpr const char *kColumns[kNPars] = {"A", "Tau_rise", "Tau_fall", "R_slow", "Tau_slow"}; /**< @brief Columns of the parameters file */
+
+    /** @brief Samples the parameters as a whole row of the parameters file. */
+    static inline void Sample(TH3D*, const std::vector<Double_t> &rows, TRandom *rand, Double_t *p)
+    {
+        SamplePulseRow<kNPars>(rows, rand, p);
+    }
+
+    /** @brief Value at t of the waveform with parameters p, starting at timePhel. */
+    static inline Float_t Eval(Float_t t, const Double_t *p, Double_t timePhel)
+    {
+        Double_t dt = t - timePhel;
+        Double_t expRise = TMath::Exp(-dt/p[1]);
+        Double_t expDec = TMath::Exp(-dt/p[2]);
+        Double_t expSlow = TMath::Exp(-dt/p[4]);
+
+        Float_t funcVal = static_cast<Float_t>(p[0]*(expRise - (1-p[3])*expDec - p[3]*expSlow)*((t > timePhel) ? 1:0));
+
+        // Numerical fixing
+        if(funcVal > 0 || TMath::IsNaN(funcVal)) funcVal = 0;
+        return funcVal;
+    }
+    /** @brief Longest time constant [ns] of the waveform. */
+    static inline Double_t Duration(const Double_t *p) { return TMath::Max(p[1], TMath::Max(p[2], p[4])); }
+};
+
+
+/**
+ * @brief 1-Phel waveform with independent fast and slow components, sharing
+ * the rise time.
+ *
+ * \f[
+ * \text{wave}(t) = -\Big( A_{\text{FAST}}\, e^{-\Delta t/\tau_{\text{FAST}}} + A_{\text{SLOW}}\, e^{-\Delta t/\tau_{\text{SLOW}}} \Big) \Big( 1 - e^{-\Delta t/\tau_{\text{RISE}}} \Big) \theta(\Delta t)
+ * \f]
+ */
+struct FastSlowPulse
+{
+    static constexpr const char *kName = "fastslow"; /**< @brief Name of the model in the mac */
+    static constexpr Int_t kNPars = 5; /**< @brief Number of parameters */
+    static constexpr const char *kColumns[kNPars] = {"A_fast", "Tau_fast", "A_slow", "Tau_slow", "Tau_rise"}; /**< @brief Columns of the parameters file */
+
+    /** @brief Samples the parameters as a whole row of the parameters file. */
+    static inline void Sample(TH3D*, const std::vector<Double_t> &rows, TRandom *rand, Double_t *p)
+    {
+        SamplePulseRow<kNPars>(rows, rand, p);
+    }
+
+    /** @brief Value at t of the waveform with parameters p, starting at timePhel. */
+    static inline Float_t Eval(Float_t t, const Double_t *p, Double_t timePhel)
+    {
+        Double_t dt = t - timePhel;
+        Double_t decay = p[0]*TMath::Exp(-dt/p[1]) + p[2]*TMath::Exp(-dt/p[3]);
+
+        Float_t funcVal = static_cast<Float_t>(-decay*(1 - TMath::Exp(-dt/p[4]))*((t > timePhel) ? 1:0));
+
+        // Numerical fixing
+        if(funcVal > 0 || TMath::IsNaN(funcVal)) funcVal = 0;
+        return funcVal;
+    }
+    /** @brief Longest time constant [ns] of the waveform. */
+    static inline Double_t Duration(const Double_t *p) { return TMath::Max(p[1], TMath::Max(p[3], p[4])); }
+};
+
+
+#endif  // PULSE_HH
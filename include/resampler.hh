@@ -0,0 +1,76 @@
+/**
+ * @file resampler.hh
+ * @brief Declaration of the class Resampler, the band-limited conversion of
+ * the waveforms from the synthesis rate to the sampling speed of the DAQ
+ *
+ * The ratio of the two rates is approximated by a fraction L/M. The output
+ * sample n falls at the input position n*M/L, whose fractional part takes
+ * only L values: the windowed-sinc anti-aliasing filter is tabulated once
+ * for each of these phases (polyphase filter), so that every output sample
+ * is a short dot product with contiguous input samples. The cut-off is at
+ * the Nyquist frequency of the slower of the two rates.
+ *
+ * For sampling times that are not on a uniform grid (bin size spread) the
+ * filter is evaluated at each time instead.
+ */
+#ifndef RESAMPLER_HH
+#define RESAMPLER_HH
+
+#include <vector>
+
+class Resampler
+{
+public:
+    /**
+     * @brief Prepares the conversion.
+     *
+     * @param rateIn Rate [GSPS] of the input (synthesis) grid
+     * @param rateOut Rate [GSPS] of the output grid
+     * @param nOut Number of output samples
+     * @return false if the ratio is not close to a fraction with denominator
+     * up to @ref kMaxPhases
+     */
+    bool Init(double rateIn, double rateOut, int nOut);
+
+    /**
+     * @brief Number of input samples, covering the output window plus
+     * half a filter length before and after it.
+     */
+    inline int GetInputLength() const { return fInputLength; }
+    /**
+     * @brief Time [ns] of the input sample i, with the output window starting
+     * at 0.
+     */
+    inline double GetInputTime(int i) const { return (i - fHalfTaps) / fRateIn; }
+
+    /**
+     * @brief Converts a waveform to the uniform output grid.
+     *
+     * @param in GetInputLength() samples
+     * @param out nOut samples, overwritten
+     */
+    void Process(const float *in, float *out) const;
+    /**
+     * @brief Converts a waveform to arbitrary output times [ns], within the
+     * window of the input.
+     */
+    void ProcessAt(const float *in, const float *times, float *out) const;
+
+    static constexpr int kHalfLength = 8; /**< @brief Half length of the filter, in periods of the slower rate */
+    static constexpr int kMaxPhases = 256; /**< @brief Largest denominator of the rate ratio */
+
+private:
+    /** @brief Windowed-sinc filter at offset x [input samples] from the output time. */
+    double Kernel(double x) const;
+
+    double fRateIn = 1;
+    int fHalfTaps = kHalfLength; /**< @brief Input samples on each side of an output sample */
+    double fCutoff = 1; /**< @brief Cut-off relative to the input Nyquist frequency */
+    int fL = 1, fM = 1;
+    int fNOut = 0;
+    int fInputLength = 0;
+    std::vector<float> fCoefficients; /**< @brief [phase][2*fHalfTaps] filter taps */
+};
+
+
+#endif  // RESAMPLER_HH
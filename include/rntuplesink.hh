@@ -0,0 +1,62 @@
+/**
+ * @file rntuplesink.hh
+ * @brief Declaration of the class RNTupleSink, the RNTuple writer of the
+ * waveforms
+ *
+ * RNTuple needs ROOT 6.32 or later: with older versions @ref
+ * RNTupleSink::IsAvailable() returns false and the waveforms go to the
+ * lyso_wfs TTree. The ROOT classes are hidden in the implementation so that
+ * this header compiles with every version.
+ */
+#ifndef RNTUPLESINK_HH
+#define RNTUPLESINK_HH
+
+#include <vector>
+
+#include <Rtypes.h>
+
+class TFile;
+
+/**
+ * @brief Writes the waveforms in the RNTuples lyso_wfs (Event, Front, Back)
+ * and lyso_wfs_times (Time_F, Time_B), with the same fields as the TTrees of
+ * the "file" sink.
+ */
+class RNTupleSink
+{
+public:
+    RNTupleSink() = default;
+    ~RNTupleSink() { Close(); }
+
+    /** @brief Whether this ROOT version supports the RNTuple writer. */
+    static Bool_t IsAvailable();
+
+    /**
+     * @brief Creates the lyso_wfs RNTuple in an open file.
+     *
+     * @param file Output file (the RNTuples are committed by @ref Close(),
+     * which must come before the file is closed)
+     * @param compression ROOT compression settings of the pages (compressed
+     * in parallel if the caller enabled the implicit multithreading of ROOT)
+     * @return false if RNTuple is not available
+     */
+    Bool_t Open(TFile *file, Int_t compression);
+    /** @brief Writes the sampling times, once per run, in lyso_wfs_times. */
+    void SetTimes(const std::vector<std::vector<Float_t>> &times_F, const std::vector<std::vector<Float_t>> &times_B);
+    /** @brief Appends an event to lyso_wfs, binding its waveforms without a copy. */
+    void Fill(Int_t event, const std::vector<std::vector<Float_t>> &front, const std::vector<std::vector<Float_t>> &back);
+    /** @brief Commits the RNTuples to the file. */
+    void Close();
+
+    inline Long64_t GetEntries() const { return fEntries; } /**< @brief Returns the number of events written. */
+
+private:
+    struct Impl;
+    Impl *fImpl = nullptr; /**< @brief Writers and fields, defined only if RNTuple is available */
+    TFile *fFile = nullptr;
+    Int_t fCompression = 0;
+    Long64_t fEntries = 0;
+};
+
+
+#endif  // RNTUPLESINK_HH
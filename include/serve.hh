@@ -0,0 +1,50 @@
+/**
+ * @file serve.hh
+ * @brief Declaration of the function @ref Bartender_Serve(), the daemon mode
+ * that keeps configured generators warm between short jobs
+ *
+ * The jobs are text files with the extension .job dropped in a spool
+ * directory, with the same "key = value" lines of the mac files:
+ * @code
+ * Input = MCID_1707049321.root
+ * Output = RootFiles/BarID_1707049321_part3.root
+ * First entry = 3000
+ * Last entry = 4000
+ * @endcode
+ * Output defaults to ./RootFiles/BarID_<MCID>_t<worker>_<job>.root, with
+ * the MCID of the input file name (./RootFiles/output_<job>.root if it has
+ * none). A job whose output can't be created fails. The entries default to the
+ * whole file (Last entry excluded, -1 for the end). Each job is seeded from
+ * its input file and entry range, so it gives the same output on any worker.
+ * To avoid picking up half-written jobs, write them under another name and
+ * rename them to .job.
+ *
+ * A job is claimed by renaming it to .job.running, and ends as .job.done or
+ * .job.failed. Its status (queued, running, done or failed), entries, wall
+ * time and rate are kept up to date in a .status file next to it. The daemon
+ * stops when a file named "stop" appears in the spool directory, or on
+ * SIGINT/SIGTERM, after the jobs already claimed, and removes the stop file.
+ */
+#ifndef SERVE_HH
+#define SERVE_HH
+
+#include <string>
+
+#include <Rtypes.h>
+
+/**
+ * @brief Runs the daemon mode until it is stopped.
+ *
+ * Each worker thread owns a generator configured once from the mac file, with
+ * the distribution of the parameters already built, and runs one job at a
+ * time, reopening only the input and the output files.
+ *
+ * @param sipmFilename Mac file of the generators
+ * @param spoolDir Directory polled for the jobs
+ * @param nWorkers Number of worker threads
+ * @return The exit code: 0, or 1 if the spool directory can't be used
+ */
+Int_t Bartender_Serve(const char *sipmFilename, const std::string &spoolDir, Int_t nWorkers);
+
+
+#endif  // SERVE_HH
@@ -0,0 +1,71 @@
+/**
+ * @file settings.hh
+ * @brief Definition of the struct BarSettings
+ */
+#ifndef SETTINGS_HH
+#define SETTINGS_HH
+
+#include <cfloat>
+#include <string>
+
+#include <Rtypes.h>
+
+#include "globals.hh"
+#include "SiPM.hh"
+#include "output.hh"
+#include "features.hh"
+#include "filter.hh"
+
+/**
+ * @brief Struct for storing all the settings of a BarLYSO, as an alternative
+ * to the mac file when the synthesis is embedded in another program.
+ *
+ * The defaults are those of the SiPM.mac template. See @ref
+ * Bartender_Configure(const BarSettings&, BarLYSO*).
+ */
+struct BarSettings
+{
+    // SiPM
+    SiPMNoise fSiPMNoise; /**< @brief Dark counts, crosstalk and afterpulses (all off by default) */
+
+    // Template working point
+    Float_t fSamplingSpeed_Template = 1; /**< @brief Sampling speed [GSPS] of the template data */
+    Double_t fR_shaper_Template = 1.58E3; /**< @brief Resistance [Ohm] of the shaper of the template data */
+    Float_t fGain_Template = 74; /**< @brief Gain [dB] of the template data */
+
+    // Simulated DAQ
+    Bool_t fIsBinSizeConstant = false; /**< @brief Whether the bins have constant width */
+    Float_t fSamplingSpeed = 1; /**< @brief Simulated sampling speed [GSPS] */
+    Float_t fSigmaBinSize = 0.01; /**< @brief Spread [ns] of the bin width, if not constant */
+    Int_t fJitterPool = 0; /**< @brief Jittered grids assigned to the channels event by event (0 = one grid per run) */
+    Float_t fSamplingSpeed_Synthesis = 0; /**< @brief Rate [GSPS] of the synthesis grid, resampled to fSamplingSpeed (0 = off, < 0 = template rate) */
+    Bool_t fIsShaping = false; /**< @brief Whether to use the shaping */
+    Double_t fTau_shaping = 1; /**< @brief Time constant [ns] of the shaping */
+    Float_t fGain = 28; /**< @brief Simulated gain [dB] */
+    Float_t fSigmaNoise = 0.005; /**< @brief Simulated noise [V] */
+    std::string fCalibrationTable; /**< @brief Per-channel gain, baseline and noise (empty = global values) */
+    Float_t fADCRange[2] = {-FLT_MAX, FLT_MAX}; /**< @brief Clipping levels [V] of the ADC: min, max */
+    Int_t fApproxThreshold = 0; /**< @brief Photons per channel above which the waveform is approximated (0 = off) */
+    Int_t fChannels = CHANNELS; /**< @brief Number of channels per detector */
+    Int_t fSamplings = SAMPLINGS; /**< @brief Number of samplings per waveform */
+
+    // Template parameters
+    std::string fPulseModel = "2exp"; /**< @brief Model of the 1-Phel waveform: 2exp, 3exp or fastslow */
+    Double_t fFreeRunningRate = 0; /**< @brief Event rate [MHz] of the free-running mode (0 = off) */
+    std::string fOverlayLibrary; /**< @brief Library of background waveforms to overlay (empty = off) */
+    Int_t fOverlayEvents = 1; /**< @brief Background events overlaid on each event */
+    Double_t fOverlayWindow = 200; /**< @brief Maximum time shift [ns] of the overlaid events */
+    std::string fParsFilename = "../pars_datasets/FitParams_T20_V570.txt"; /**< @brief Text file of the best-fit parameters */
+    Double_t fChargeCuts[2] = {0.7, 2.4}; /**< @brief Cuts in the charge spectrum: min, max */
+    Double_t fHisto_A[3] = {50, 0, 5}; /**< @brief Histogram of A: nbins, min, max */
+    Double_t fHisto_Tau_rise[3] = {50, 0, 6}; /**< @brief Histogram of Tau_rise: nbins, min, max */
+    Double_t fHisto_Tau_dec[3] = {50, 0, 25}; /**< @brief Histogram of Tau_dec: nbins, min, max */
+
+    // Output
+    OutputSettings fOutput; /**< @brief Settings of the output file, used only if it is opened */
+    FeatureSettings fFeatures; /**< @brief Settings of the inline feature extraction */
+    EventFilter fFilter; /**< @brief Selection of the channels and of the events */
+};
+
+
+#endif  // SETTINGS_HH
@@ -0,0 +1,148 @@
+/**
+ * @file shmring.hh
+ * @brief Declaration of the classes ShmProducer and ShmConsumer, the two ends
+ * of the shared-memory ring buffer of waveforms
+ *
+ * The ring buffer lives in a POSIX shared-memory segment and has a single
+ * producer (bartender) and a single consumer (an analysis process on the same
+ * node). It doesn't depend on ROOT: consumers only need this header and the
+ * bartendershm library.
+ *
+ * Consumer side, in short:
+ * @code
+ * ShmConsumer consumer;
+ * consumer.Open("/BarID_1707049321", 10000);
+ * ShmEventView view;
+ * while(consumer.Acquire(view, 10000))
+ * {
+ *     // view.fFront[ch*view.fSamplings + bin], view.fBack[...]: no copies
+ *     consumer.Release();
+ * }
+ * @endcode
+ */
+#ifndef SHMRING_HH
+#define SHMRING_HH
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Header at the beginning of the shared-memory segment.
+ *
+ * It is followed by the sampling times of the Front and Back detectors
+ * ([channels][samplings] floats each) and by the slots. Every slot holds the
+ * event number followed by the Front and Back waveforms, each
+ * [channels][samplings] floats.
+ */
+struct ShmRingHeader
+{
+    uint32_t fMagic; /**< @brief Marks an initialized segment */
+    uint32_t fSlots; /**< @brief Number of slots of the ring */
+    uint32_t fChannels; /**< @brief Number of channels per detector */
+    uint32_t fSamplings; /**< @brief Number of samplings per waveform */
+    uint64_t fSlotSize; /**< @brief Size of a slot [bytes] */
+    alignas(64) std::atomic<uint64_t> fHead; /**< @brief Number of events published (written only by the producer) */
+    alignas(64) std::atomic<uint64_t> fTail; /**< @brief Number of events released (written only by the consumer) */
+    alignas(64) std::atomic<uint32_t> fIsDone; /**< @brief Set by the producer at the end of the run */
+};
+
+
+/**
+ * @brief View of an event in the ring, valid until @ref ShmConsumer::Release().
+ */
+struct ShmEventView
+{
+    int32_t fEvent; /**< @brief Event number */
+    uint32_t fChannels; /**< @brief Number of channels per detector */
+    uint32_t fSamplings; /**< @brief Number of samplings per waveform */
+    const float *fFront; /**< @brief Front waveforms, [channels][samplings] */
+    const float *fBack; /**< @brief Back waveforms, [channels][samplings] */
+    const float *fTimes_F; /**< @brief Sampling times of the Front detector, [channels][samplings] */
+    const float *fTimes_B; /**< @brief Sampling times of the Back detector, [channels][samplings] */
+};
+
+
+/**
+ * @brief Producer end of the ring: creates the segment and publishes events.
+ */
+class ShmProducer
+{
+public:
+    ShmProducer() = default;
+    ~ShmProducer() { Close(0); }
+
+    /**
+     * @brief Creates (replacing any stale one) the shared-memory segment.
+     *
+     * @return false if the segment can't be created or mapped
+     */
+    bool Open(const std::string &name, uint32_t slots, uint32_t channels, uint32_t samplings);
+    /**
+     * @brief Copies the sampling times into the segment, for the consumers.
+     */
+    void SetTimes(const std::vector<std::vector<float>> &times_F, const std::vector<std::vector<float>> &times_B);
+    /**
+     * @brief Publishes an event, waiting up to timeoutMs for a free slot.
+     *
+     * @return false if the ring is still full after the timeout (back-pressure:
+     * the caller decides where to put the event instead)
+     */
+    bool Publish(int32_t event, const std::vector<std::vector<float>> &front, const std::vector<std::vector<float>> &back, int timeoutMs);
+    /**
+     * @brief Marks the end of the run, waits up to timeoutMs for the consumer
+     * to drain the ring and removes the segment.
+     */
+    void Close(int timeoutMs);
+
+    inline bool IsOpen() const { return fHeader != nullptr; } /**< @brief Returns whether the segment is mapped. */
+
+private:
+    std::string fName;
+    void *fBase = nullptr;
+    size_t fSize = 0;
+    ShmRingHeader *fHeader = nullptr;
+};
+
+
+/**
+ * @brief Consumer end of the ring: attaches to the segment and reads the
+ * events in place.
+ */
+class ShmConsumer
+{
+public:
+    ShmConsumer() = default;
+    ~ShmConsumer() { Close(); }
+
+    /**
+     * @brief Attaches to the segment, waiting up to timeoutMs for the producer
+     * to create it.
+     */
+    bool Open(const std::string &name, int timeoutMs);
+    /**
+     * @brief Waits up to timeoutMs for the next event and returns a view of it.
+     *
+     * @return false on timeout, or when the producer is done and the ring is
+     * empty
+     */
+    bool Acquire(ShmEventView &view, int timeoutMs);
+    /**
+     * @brief Gives the slot of the last acquired event back to the producer.
+     */
+    void Release();
+    /**
+     * @brief Detaches from the segment.
+     */
+    void Close();
+
+private:
+    void *fBase = nullptr;
+    size_t fSize = 0;
+    ShmRingHeader *fHeader = nullptr;
+};
+
+
+#endif  // SHMRING_HH
@@ -13,7 +13,9 @@
  * @param macrofile Path to the macro file containing configuration details.
  * @param MCID Unique identifier for the Monte Carlo simulation.
  * @param duration Duration of the simulation in seconds.
+ * @param notes Lines appended after the settings of the macro, e.g. the
+ * report of --autotune (empty for none).
  */
-void Bartender_Summary(const std::string& macrofile, int MCID, double duration);
+void Bartender_Summary(const std::string& macrofile, int MCID, double duration, const std::string& notes = "");
 
 #endif // SUMMARY_HH
@@ -0,0 +1,99 @@
+/**
+ * @file trace.hh
+ * @brief Declaration of the per-event timeline tracing, in Chrome trace
+ * format
+ *
+ * Each stage of an event is timed by a TraceScope on the stack:
+ * @code
+ * {
+ *     TraceScope scope("synthesis", event, nPhotons);
+ *     ...
+ * }
+ * @endcode
+ * The intervals go to a buffer owned by the calling thread, without locks,
+ * and are written by Trace::Stop() as a JSON file that chrome://tracing and
+ * ui.perfetto.dev can open. When tracing is off a scope costs one branch.
+ */
+#ifndef TRACE_HH
+#define TRACE_HH
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Rtypes.h>
+
+namespace Trace
+{
+    extern Bool_t gIsEnabled; /**< @brief Whether the scopes are recorded */
+
+    /**
+     * @brief Enables the tracing.
+     *
+     * @param filename JSON file written by @ref Stop()
+     * @param processID Process of the timeline: the worker ID of bartenderMT,
+     * or -1 for a single process
+     */
+    void Start(const std::string &filename, Int_t processID);
+    /**
+     * @brief Disables the tracing and writes the intervals of all the
+     * threads. To be called when the traced threads are done.
+     */
+    void Stop();
+    /**
+     * @brief Merges the traces of several processes (e.g. the workers of
+     * bartenderMT) into a single timeline.
+     *
+     * @return false if no input can be read
+     */
+    Bool_t Merge(const std::vector<std::string> &inputs, const std::string &output);
+
+    /** @brief Monotonic timestamp [ns], common to all the processes of the node. */
+    inline int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    /** @brief Appends an interval to the buffer of the calling thread. */
+    void Record(const char *name, int64_t begin, int64_t end, Long64_t event, Long64_t photons);
+}
+
+
+/**
+ * @brief Records the interval between its construction and its destruction.
+ */
+class TraceScope
+{
+public:
+    /**
+     * @param name Name of the stage (a string literal: it's not copied)
+     * @param event Event number, shown as argument
+     * @param photons Number of photons, shown as argument if not negative
+     */
+    TraceScope(const char *name, Long64_t event, Long64_t photons = -1)
+    {
+        if(!Trace::gIsEnabled)
+            return;
+        fName = name;
+        fEvent = event;
+        fPhotons = photons;
+        fBegin = Trace::Now();
+    }
+    ~TraceScope()
+    {
+        if(fName)
+            Trace::Record(fName, fBegin, Trace::Now(), fEvent, fPhotons);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope &operator=(const TraceScope&) = delete;
+
+private:
+    const char *fName = nullptr; /**< @brief Name of the stage, null if not recording */
+    int64_t fBegin = 0;
+    Long64_t fEvent = 0;
+    Long64_t fPhotons = -1;
+};
+
+
+#endif  // TRACE_HH
@@ -0,0 +1,259 @@
+/** 
+ * @file approx.cc
+ * @brief Definition of the methods of the class BarLYSO for the high-occupancy
+ * approximation
+ */
+#include "bar.hh"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+using namespace TMath;
+
+
+namespace
+{
+    constexpr Int_t APPROX_OVERSAMPLING = 8; // Lag bins per sampling period
+    constexpr Int_t APPROX_PULSES = 5000; // 1-Phel waveforms sampled to tabulate mean and variance
+    constexpr UInt_t APPROX_SEED = 4357; // Seed of the generator of the table, independent of the run
+}
+
+
+
+void BarLYSO::SetFrontWaveforms(Int_t nHits, const Int_t *channels, const Double_t *starts)
+{
+    SetWaveforms(true, nHits, channels, starts);
+}
+
+
+
+void BarLYSO::SetBackWaveforms(Int_t nHits, const Int_t *channels, const Double_t *starts)
+{
+    SetWaveforms(false, nHits, channels, starts);
+}
+
+
+
+void BarLYSO::SetWaveforms(Bool_t isFront, Int_t nHits, const Int_t *channels, const Double_t *starts)
+{
+    // The noise pulses of the SiPMs are correlated with the photons
+    if(fSiPMNoise.IsEnabled())
+    {
+        for(Int_t j = 0; j < nHits; j++)
+        {
+            if(IsValidChannel(channels[j]))
+                fAvalanches[channels[j]].push_back(starts[j]);
+        }
+        AddSiPMNoise(isFront);
+    }
+
+    // Photon by photon if the approximation is off, in reference mode, if
+    // the photons must be recorded with their own parameters or if they are
+    // synthesized on a finer grid
+    if(fApproxThreshold <= 0 || fIsRecordingPhotons || fIsReference || fResampler)
+    {
+        for(Int_t j = 0; j < nHits; j++)
+        {
+            if(isFront) SetFrontWaveform(channels[j], starts[j]);
+            else SetBackWaveform(channels[j], starts[j]);
+        }
+        if(fResampler)
+            ResampleWaveforms(isFront);
+        return;
+    }
+
+    // Count the photons of each channel (none in the masked ones)
+    const vector<Char_t> &mask = isFront ? fMask_F : fMask_B;
+    vector<Int_t> counts(fChannels, 0);
+    for(Int_t j = 0; j < nHits; j++)
+    {
+        if(IsValidChannel(channels[j]) && mask[channels[j]])
+            counts[channels[j]]++;
+    }
+
+    // Exact synthesis below the threshold, collect the times above it
+    fApproxStarts.resize(fChannels);
+    for(Int_t j = 0; j < nHits; j++)
+    {
+        if(!IsValidChannel(channels[j]) || !mask[channels[j]])
+            continue;
+        if(counts[channels[j]] > fApproxThreshold)
+            fApproxStarts[channels[j]].push_back(starts[j]);
+        else if(isFront)
+            SetFrontWaveform(channels[j], starts[j]);
+        else
+            SetBackWaveform(channels[j], starts[j]);
+    }
+
+    SideFeatures &features = isFront ? fFeatures_F : fFeatures_B;
+    for(Int_t ch = 0; ch < fChannels; ch++)
+    {
+        if(fApproxStarts[ch].empty())
+            continue;
+
+        if(fFeatureSettings.fIsEnabled)
+        {
+            for(Double_t start : fApproxStarts[ch])
+                features.AddPhoton(ch, start);
+        }
+
+        ActivateChannel(isFront, ch);
+        AddApproxChannel(isFront ? fFront[ch] : fBack[ch], GetChannelTimes(isFront, ch), fApproxStarts[ch]);
+        fApproxStarts[ch].clear();
+    }
+}
+
+
+
+void BarLYSO::BuildApproxPulse()
+{
+    // Cover the whole window, also with non-constant bins
+    fApproxStep = 1. / (fDAQ->fSamplingSpeed * APPROX_OVERSAMPLING);
+    Int_t nLags = (3 * fSamplings * APPROX_OVERSAMPLING) / 2;
+
+    // A generator of its own: the table is the same whenever it's built, and
+    // the random sequences of the events don't depend on it
+    TRandom3 rand(APPROX_SEED);
+    vector<Double_t> sum(nLags, 0), sum2(nLags, 0);
+    for(Int_t p = 0; p < APPROX_PULSES; p++)
+    {
+        Double_t pars[MAX_PULSE_PARS];
+        fSamplePulse(hPars, fPulseRows, &rand, pars);
+
+        // Beyond 20 time constants the waveform is negligible
+        Int_t lastLag = Min(nLags, (Int_t) (20 * fPulseDuration(pars) / fApproxStep) + 1);
+        for(Int_t l = 0; l < lastLag; l++)
+        {
+            Double_t value = fEvalPulse(l * fApproxStep, pars, 0);
+            sum[l] += value;
+            sum2[l] += value * value;
+        }
+    }
+
+    fApproxMean.resize(nLags);
+    fApproxVar.resize(nLags);
+    for(Int_t l = 0; l < nLags; l++)
+    {
+        Double_t mean = sum[l] / APPROX_PULSES;
+        fApproxMean[l] = mean;
+        fApproxVar[l] = Max(0., sum2[l] / APPROX_PULSES - mean * mean);
+    }
+}
+
+
+
+void BarLYSO::AddApproxChannel(vector<Float_t> &wave, const vector<Float_t> &times, vector<Double_t> &starts)
+{
+    if(fApproxMean.empty())
+        BuildApproxPulse();
+
+    // Histogram of the arrival times
+    sort(starts.begin(), starts.end());
+    vector<Long64_t> binIndex;
+    vector<Int_t> binCount;
+    for(Double_t start : starts)
+    {
+        Long64_t index = (Long64_t) floor((start + ZERO_TIME_BIN) / fApproxStep);
+        if(!binIndex.empty() && binIndex.back() == index)
+            binCount.back()++;
+        else
+        {
+            binIndex.push_back(index);
+            binCount.push_back(1);
+        }
+    }
+
+    // Convolution with the mean waveform and its variance
+    Int_t nLags = fApproxMean.size();
+    vector<Double_t> var(fSamplings, 0);
+    for(size_t b = 0; b < binIndex.size(); b++)
+    {
+        Double_t center = (binIndex[b] + 0.5) * fApproxStep;
+        Int_t first = lower_bound(times.begin(), times.end(), center) - times.begin();
+        for(Int_t bin = first; bin < fSamplings; bin++)
+        {
+            Int_t lag = Nint((times[bin] - center) / fApproxStep);
+            if(lag >= nLags)
+                break;
+            wave[bin] += binCount[b] * fApproxMean[lag];
+            var[bin] += binCount[b] * fApproxVar[lag];
+        }
+    }
+
+    // Fluctuations of the 1-Phel parameters
+    for(Int_t bin = 0; bin < fSamplings; bin++)
+    {
+        if(var[bin] > 0)
+            wave[bin] += fRandPars->Gaus(0, Sqrt(var[bin]));
+    }
+}
+
+
+
+void BarLYSO::ValidateApprox(const char *filename)
+{
+    const vector<Int_t> nPhotons = {100, 300, 1000, 3000, 10000};
+    const Int_t nTrials = 50;
+    const Double_t tauScint = 40.; // LYSO decay time [ns]
+
+    if(fApproxMean.empty())
+        BuildApproxPulse();
+
+    ofstream report(filename);
+    report << "# Exact vs approximated synthesis of one channel, " << nTrials << " channels per row\n";
+    report << "# Photon times from an exponential decay with tau = " << tauScint << " ns; no gain and noise\n";
+    report << "# NPhotons  Amp_exact RMS  Amp_approx RMS  Charge_exact RMS  Charge_approx RMS  Peak_exact RMS  Peak_approx RMS  ms_exact ms_approx\n";
+
+    SideFeatures features;
+    features.Resize(1);
+    for(Int_t n : nPhotons)
+    {
+        vector<Float_t> amplitude[2], charge[2], peak[2];
+        Double_t duration[2] = {0, 0};
+        for(Int_t trial = 0; trial < nTrials; trial++)
+        {
+            vector<Double_t> starts(n);
+            for(Int_t j = 0; j < n; j++)
+                starts[j] = fRandPars->Exp(tauScint);
+
+            for(Int_t method = 0; method < 2; method++)
+            {
+                vector<Float_t> wave(fSamplings, 0);
+                vector<Double_t> approxStarts = starts;
+                auto start_chrono = chrono::high_resolution_clock::now();
+                if(method == 0)
+                {
+                    for(Double_t start : starts)
+                    {
+                        Double_t pars[MAX_PULSE_PARS];
+                        SamplePulsePars(pars);
+                        AddOnePhel(wave, GetChannelTimes(true, 0), pars, start);
+                    }
+                }
+                else
+                {
+                    AddApproxChannel(wave, GetChannelTimes(true, 0), approxStarts);
+                }
+                chrono::duration<double, milli> elapsed = chrono::high_resolution_clock::now() - start_chrono;
+                duration[method] += elapsed.count();
+
+                ExtractFeatures(wave.data(), GetChannelTimes(true, 0).data(), fSamplings, fFeatureSettings, features, 0);
+                amplitude[method].push_back(features.fAmplitude[0]);
+                charge[method].push_back(features.fCharge[0]);
+                peak[method].push_back(features.fPeakTime[0]);
+            }
+        }
+
+        report << n;
+        for(auto *estimator : {amplitude, charge, peak})
+        {
+            for(Int_t method = 0; method < 2; method++)
+                report << "  " << Mean(nTrials, estimator[method].data()) << " " << RMS(nTrials, estimator[method].data());
+        }
+        report << "  " << duration[0] / nTrials << " " << duration[1] / nTrials << "\n";
+    }
+
+    report.close();
+    cout << "Approximation report written to " << filename << endl;
+}
@@ -0,0 +1,211 @@
+/**
+ * @file autotune.cc
+ * @brief Definition of the function @ref Bartender_Autotune()
+ */
+#include "autotune.hh"
+
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <sys/stat.h>
+
+#include "configure.hh"
+#include "eventloop.hh"
+
+using namespace std;
+
+
+namespace
+{
+    const vector<pair<string, Int_t>> AUTOTUNE_COMPRESSIONS = {{"ZLIB", 1}, {"LZ4", 4}, {"ZSTD", 1}, {"ZSTD", 5}, {"LZMA", 1}};
+    const vector<Int_t> AUTOTUNE_BASKETS = {32000, 256000, 1024000}; // Basket sizes [bytes] of all the branches
+
+    /**
+     * @brief Settings and measurements of a candidate.
+     */
+    struct Candidate
+    {
+        OutputSettings fOutput;
+        Double_t fEventsPerSecond = 0;
+        Double_t fBytesPerSecond = 0;
+        Long64_t fMemory = 0; /**< @brief Memory [bytes] of the baskets at the end of the sample */
+        Bool_t fIsWithinBudget = true;
+    };
+
+    string Label(const OutputSettings &output)
+    {
+        ostringstream label;
+        if(output.fCompressionAlgorithm.empty())
+            label << "default compression";
+        else
+            label << output.fCompressionAlgorithm << " " << ((output.fCompressionLevel < 0) ? 4 : output.fCompressionLevel);
+        auto all = output.fBasketSizes.find("*");
+        if(all != output.fBasketSizes.end())
+            label << ", baskets " << all->second << " B";
+        else
+            label << ", default baskets";
+
+        return label.str();
+    }
+
+    /** @brief Writes the sample with the settings of the candidate and measures it. */
+    void RunCandidate(BarLYSO *trial, McInput &mc, Long64_t nEvents, Long64_t memoryBudget, Candidate &candidate)
+    {
+        *trial->GetOutput() = candidate.fOutput;
+        auto start_chrono = chrono::high_resolution_clock::now();
+
+        if(!trial->OpenOutput())
+        {
+            candidate.fIsWithinBudget = false;
+            return;
+        }
+        trial->SetSamplingTimes();
+        Bartender_Loop(trial, mc, 0, nEvents, {}, nullptr, "");
+        candidate.fMemory = trial->GetBasketMemory();
+        trial->SaveBar();
+        trial->CloseOutput();
+
+        chrono::duration<double> duration = chrono::high_resolution_clock::now() - start_chrono;
+        struct stat st;
+        Long64_t bytes = (stat(trial->GetOutputFilename().c_str(), &st) == 0) ? st.st_size : 0;
+        remove(trial->GetOutputFilename().c_str());
+
+        candidate.fEventsPerSecond = nEvents / duration.count();
+        candidate.fBytesPerSecond = bytes / duration.count();
+        candidate.fIsWithinBudget = (memoryBudget <= 0 || candidate.fMemory <= memoryBudget);
+        cout << "Autotune>> " << Label(candidate.fOutput) << ": " << candidate.fEventsPerSecond << " events/s, " << candidate.fBytesPerSecond / 1.e6 << " MB/s, " << candidate.fMemory / 1.e6 << " MB of baskets" << endl;
+    }
+
+    /**
+     * @brief Returns the index of the best candidate within the budget: the
+     * smallest output among the fastest ones (-1 if none).
+     */
+    Int_t ChooseCandidate(const vector<Candidate> &candidates)
+    {
+        Double_t fastest = 0;
+        for(const Candidate &c : candidates)
+        {
+            if(c.fIsWithinBudget)
+                fastest = max(fastest, c.fEventsPerSecond);
+        }
+
+        Int_t best = -1;
+        for(size_t i = 0; i < candidates.size(); i++)
+        {
+            const Candidate &c = candidates[i];
+            if(!c.fIsWithinBudget || c.fEventsPerSecond < (1 - AUTOTUNE_SPEED_TOLERANCE) * fastest)
+                continue;
+            Double_t bytesPerEvent = c.fBytesPerSecond / c.fEventsPerSecond;
+            if(best < 0 || bytesPerEvent < candidates[best].fBytesPerSecond / candidates[best].fEventsPerSecond)
+                best = i;
+        }
+
+        return best;
+    }
+}
+
+
+
+Bool_t Bartender_Autotune(BarLYSO *bar, const char *mcFilename, const char *sipmFilename, Int_t threadID, Long64_t nEvents, Long64_t memoryBudget, string &report)
+{
+    OutputSettings base = *bar->GetOutput();
+    if(base.fSink != "file" && base.fSink != "rntuple")
+    {
+        cerr << "Autotune: nothing to tune with the " << base.fSink << " sink" << endl;
+        return false;
+    }
+
+    // A generator of its own, so that the random sequences of bar are not
+    // consumed by the sample
+    SiPM sipm;
+    unique_ptr<BarLYSO> trial(new BarLYSO(mcFilename, threadID));
+    Bartender_Configure(sipmFilename, trial.get(), &sipm);
+    trial->SetFilter(bar->GetFilter());
+    string outputFilename = bar->GetOutputFilename();
+    trial->SetOutputFilename(outputFilename.substr(0, outputFilename.size() - 5) + "_autotune.root");
+
+    McInput mc;
+    if(!mc.Open(mcFilename))
+        return false;
+    nEvents = min(nEvents, mc.GetEntries());
+    if(nEvents <= 0)
+        return false;
+    trial->SetParsDistro();
+    trial->SetEvents(nEvents);
+
+    // Read the sample once, so that the first candidate doesn't pay for the
+    // cold page cache
+    for(Long64_t k = 0; k < nEvents; k++)
+        mc.GetEntry(k);
+
+    // The sample is not a run to resume, and stays within the budget
+    base.fCheckpointEvents = 0;
+    if(memoryBudget > 0 && (base.fMemoryCap <= 0 || base.fMemoryCap > memoryBudget))
+        base.fMemoryCap = memoryBudget;
+
+    // First the compression, with the baskets of the mac
+    vector<Candidate> candidates(1);
+    candidates[0].fOutput = base;
+    for(const auto &compression : AUTOTUNE_COMPRESSIONS)
+    {
+        if(compression.first == base.fCompressionAlgorithm && compression.second == base.fCompressionLevel)
+            continue;
+        candidates.emplace_back();
+        candidates.back().fOutput = base;
+        candidates.back().fOutput.fCompressionAlgorithm = compression.first;
+        candidates.back().fOutput.fCompressionLevel = compression.second;
+    }
+    for(Candidate &candidate : candidates)
+        RunCandidate(trial.get(), mc, nEvents, memoryBudget, candidate);
+
+    // Then the baskets, with the best compression
+    Int_t best = ChooseCandidate(candidates);
+    if(best >= 0)
+    {
+        OutputSettings compressed = candidates[best].fOutput;
+        for(Int_t basketSize : AUTOTUNE_BASKETS)
+        {
+            auto all = compressed.fBasketSizes.find("*");
+            if(all != compressed.fBasketSizes.end() && all->second == basketSize)
+                continue;
+            candidates.emplace_back();
+            candidates.back().fOutput = compressed;
+            candidates.back().fOutput.fBasketSizes["*"] = basketSize;
+            RunCandidate(trial.get(), mc, nEvents, memoryBudget, candidates.back());
+        }
+        best = ChooseCandidate(candidates);
+    }
+
+    ostringstream text;
+    text << "Autotune: " << nEvents << " events per candidate";
+    if(memoryBudget > 0)
+        text << ", memory budget " << memoryBudget / 1.e6 << " MB";
+    text << '\n';
+    for(const Candidate &c : candidates)
+    {
+        text << "  " << Label(c.fOutput) << ": " << c.fEventsPerSecond << " events/s, " << c.fBytesPerSecond / 1.e6 << " MB/s, " << c.fMemory / 1.e6 << " MB of baskets";
+        text << (c.fIsWithinBudget ? "\n" : " (over budget)\n");
+    }
+
+    if(best < 0)
+    {
+        cerr << "Autotune: no candidate within the memory budget, keeping the settings of the mac" << endl;
+        text << "Autotune choice: none within the budget, settings of the mac\n";
+        report = text.str();
+        return false;
+    }
+
+    // Only the tuned settings change
+    const OutputSettings &chosen = candidates[best].fOutput;
+    OutputSettings *output = bar->GetOutput();
+    output->fCompressionAlgorithm = chosen.fCompressionAlgorithm;
+    output->fCompressionLevel = chosen.fCompressionLevel;
+    output->fBasketSizes = chosen.fBasketSizes;
+    output->fMemoryCap = chosen.fMemoryCap;
+
+    cout << "Autotune>> Chosen " << Label(chosen) << endl;
+    text << "Autotune choice: " << Label(chosen) << '\n';
+    report = text.str();
+    return true;
+}
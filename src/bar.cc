@@ -3,15 +3,35 @@
  * @brief Definition of the class BarLYSO
  */
 #include "bar.hh"
+#include "trace.hh"
+
+#include <algorithm>
+#include <memory>
 
 using namespace std;
 using namespace TMath;
 
 
-BarLYSO::BarLYSO(const char*inputFilename, Int_t threadID)
+namespace
 {
-    // Set the threadID
-    fThreadID = threadID;
+    constexpr Int_t JITTER_POOL_MAX = 65536; // Grids addressable by the UShort_t indices
+
+    // Mixes the bits of a key (splitmix64 finalizer)
+    inline ULong64_t MixKey(ULong64_t key)
+    {
+        key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+        return key ^ (key >> 31);
+    }
+}
+
+
+BarLYSO::BarLYSO()
+{
+    // No thread and no run ID
+    fThreadID = -1;
+    fID = 0;
+    fOutputFilename = "./RootFiles/output.root";
 
     // Initialize the random generators
     fRandPars = new TRandom3(0);
@@ -22,25 +42,710 @@ BarLYSO::BarLYSO(const char*inputFilename, Int_t threadID)
 
     // Initialize whole WF containers [CHANNELS]x[SAMPLINGS]
     fEvent = -1;
-    fFront.resize(CHANNELS, vector<Float_t>(SAMPLINGS, 0));
-    fBack.resize(CHANNELS, vector<Float_t>(SAMPLINGS, 0)); 
-    fTimes_F.resize(CHANNELS, vector<Float_t>(SAMPLINGS, 0)); 
-    fTimes_B.resize(CHANNELS, vector<Float_t>(SAMPLINGS, 0)); 
+    SetGeometry(CHANNELS, SAMPLINGS);
+}
+
+
+
+void BarLYSO::SetGeometry(Int_t channels, Int_t samplings)
+{
+    fChannels = channels;
+    fSamplings = samplings;
+
+    fFront.assign(fChannels, vector<Float_t>(fSamplings, 0));
+    fBack.assign(fChannels, vector<Float_t>(fSamplings, 0)); 
+    fTimes_F.assign(fChannels, vector<Float_t>(fSamplings, 0)); 
+    fTimes_B.assign(fChannels, vector<Float_t>(fSamplings, 0)); 
+    fFeatures_F.Resize(fChannels);
+    fFeatures_B.Resize(fChannels);
+    fApproxMean.clear();
+
+    SetFilter(fFilter);
+    SelectKernels();
+}
+
+
+
+void BarLYSO::SetFilter(const EventFilter &filter)
+{
+    fFilter = filter;
+    if(!ParseChannelList(fFilter.fChannels_F, fChannels, fMask_F))
+    {
+        cerr << "Invalid list of Front channels \"" << fFilter.fChannels_F << "\", using all" << endl;
+        fFilter.fChannels_F = "all";
+        ParseChannelList(fFilter.fChannels_F, fChannels, fMask_F);
+    }
+    if(!ParseChannelList(fFilter.fChannels_B, fChannels, fMask_B))
+    {
+        cerr << "Invalid list of Back channels \"" << fFilter.fChannels_B << "\", using all" << endl;
+        fFilter.fChannels_B = "all";
+        ParseChannelList(fFilter.fChannels_B, fChannels, fMask_B);
+    }
+}
+
+
+
+void BarLYSO::SetPulseModel(const string &model)
+{
+    if(model != TwoExpPulse::kName && model != ThreeExpPulse::kName && model != FastSlowPulse::kName)
+    {
+        cerr << "Unknown pulse model " << model << ", using " << fPulseModel << endl;
+        return;
+    }
+
+    fPulseModel = model;
+    fApproxMean.clear();
+    SelectKernels();
+}
+
+
+
+void BarLYSO::SelectKernels()
+{
+    // Pre-instantiated geometries, generic loops otherwise (and on the
+    // synthesis grid)
+    if(fIsReference || fResampler)
+        BindKernels<GenericGeometry>();
+    else if(fChannels == 115 && fSamplings == 1024)
+        BindKernels<Geometry<115, 1024>>();
+    else if(fChannels == 115 && fSamplings == 2048)
+        BindKernels<Geometry<115, 2048>>();
+    else if(fChannels == 115 && fSamplings == 4096)
+        BindKernels<Geometry<115, 4096>>();
+    else if(fChannels == 9 && fSamplings == 1024)
+        BindKernels<Geometry<9, 1024>>();
+    else
+        BindKernels<GenericGeometry>();
+}
+
+
+
+template<class Geo>
+void BarLYSO::BindKernels()
+{
+    fDigitizeKernel = &BarLYSO::DigitizeKernel<Geo>;
+
+    if(fPulseModel == ThreeExpPulse::kName)
+        BindPulseKernels<Geo, ThreeExpPulse>();
+    else if(fPulseModel == FastSlowPulse::kName)
+        BindPulseKernels<Geo, FastSlowPulse>();
+    else
+        BindPulseKernels<Geo, TwoExpPulse>();
+}
+
+
+
+template<class Geo, class Pulse>
+void BarLYSO::BindPulseKernels()
+{
+    fAddOnePhelKernel = &BarLYSO::AddOnePhelKernel<Geo, Pulse>;
+    fAddRingPulseKernel = &BarLYSO::AddRingPulseKernel<Pulse>;
+    fAddNoiseKernel = &BarLYSO::AddNoiseKernel<Pulse>;
+    fEvalPulse = &Pulse::Eval;
+    fPulseDuration = &Pulse::Duration;
+    fSamplePulse = &Pulse::Sample;
+    fPulseColumns = Pulse::kColumns;
+    fNPulsePars = Pulse::kNPars;
+}
+
+
+
+BarLYSO::BarLYSO(const char*inputFilename, Int_t threadID) : BarLYSO()
+{
+    // Set the threadID
+    fThreadID = threadID;
 
     // Determine the output filename based on the BarLYSO ID
-    string outputFilename = GenerateOutputFilename(inputFilename);
+    fOutputFilename = GenerateOutputFilename(inputFilename);
+}
+
+
+
+void BarLYSO::ProcessEvent(Int_t event, Int_t nHits_F, const Int_t *channels_F, const Double_t *starts_F, Int_t nHits_B, const Int_t *channels_B, const Double_t *starts_B)
+{
+    InitializeBaselines(event);
+    SetFrontWaveforms(nHits_F, channels_F, starts_F);
+    SetBackWaveforms(nHits_B, channels_B, starts_B);
+    SaveEvent();
+}
+
+
+
+void BarLYSO::FillBuffers(Float_t *front, Float_t *back) const
+{
+    // Masked channels are empty: zeros in the buffers
+    for(Int_t ch = 0; ch < fChannels; ch++)
+    {
+        if(fFront[ch].empty())
+            fill_n(front + ch * fSamplings, fSamplings, 0.f);
+        else
+            copy(fFront[ch].begin(), fFront[ch].end(), front + ch * fSamplings);
+        if(fBack[ch].empty())
+            fill_n(back + ch * fSamplings, fSamplings, 0.f);
+        else
+            copy(fBack[ch].begin(), fBack[ch].end(), back + ch * fSamplings);
+    }
+}
+
+
+
+Bool_t BarLYSO::OpenOutput(Bool_t isResume)
+{
+    // The grids of each event are recorded only in the lyso_wfs tree
+    if(IsJitterPool() && fOutput.fSink != "file")
+    {
+        cerr << "The jitter pool needs the file sink, using one grid for the whole run" << endl;
+        fDAQ->fJitterPool = 0;
+    }
+
+    // Try to recover the partial file of an interrupted run
+    if(isResume && !gSystem->AccessPathName(fOutputFilename.c_str()))
+    {
+        fOutFile = TFile::Open(fOutputFilename.c_str(), "UPDATE");
+        if(fOutFile && !fOutFile->IsZombie() && RecoverCheckpoint())
+        {
+            ApplyOutputSettings();
+            OpenShm();
+            OpenOverlay();
+            if(fShm) fShm->SetTimes(fTimes_F, fTimes_B);
+            return true;
+        }
+
+        cerr << "No valid checkpoint in " << fOutputFilename << ", starting from scratch" << endl;
+        delete fOutFile;
+        fOutTree = nullptr;
+        fTimesTree = nullptr;
+        fFeaturesTree = nullptr;
+        fPhotonsTree = nullptr;
+        fResumeEntry = 0;
+        fLastEntry = -1;
+    }
 
     // Create the file.root and the TTrees
-    fOutFile = TFile::Open(outputFilename.c_str(), "RECREATE");        
+    fOutFile = TFile::Open(fOutputFilename.c_str(), "RECREATE");        
+    if(!fOutFile || fOutFile->IsZombie())
+    {
+        cerr << "Can't create the output file " << fOutputFilename << endl;
+        delete fOutFile;
+        fOutFile = nullptr;
+        return false;
+    }
     
-    fOutTree = new TTree("lyso_wfs", "lyso_wfs");
-    fOutTree->Branch("Event", &fEvent);
-    fOutTree->Branch("Front", &fFront);
-    fOutTree->Branch("Back", &fBack);
+    Bool_t isRNTuple = (fOutput.fSink == "rntuple");
+    if(isRNTuple && !RNTupleSink::IsAvailable())
+    {
+        cerr << "RNTuple needs ROOT 6.32 or later, writing the waveforms in the lyso_wfs tree" << endl;
+        isRNTuple = false;
+    }
+    Bool_t isFlat = (fOutput.fSink == "binary");
+    if((isRNTuple || isFlat) && fOutput.fCheckpointEvents > 0)
+        cerr << "Checkpoints are not supported with the " << fOutput.fSink << " sink" << endl;
+
+    if(!isRNTuple && !isFlat)
+    {
+        fOutTree = new TTree("lyso_wfs", "lyso_wfs");
+        fOutTree->Branch("Event", &fEvent);
+        fOutTree->Branch("Front", &fFront);
+        fOutTree->Branch("Back", &fBack);
+
+        fTimesTree = new TTree("lyso_wfs_times", "lyso_wfs_times");
+        if(IsJitterPool())
+        {
+            // Only the indices of the grids for each event
+            fOutTree->Branch("TimeIdx_F", &fTimeIdx_F);
+            fOutTree->Branch("TimeIdx_B", &fTimeIdx_B);
+            fTimesTree->Branch("Time_Pool", &fTimePool);
+        }
+        else
+        {
+            fTimesTree->Branch("Time_F", &fTimes_F);
+            fTimesTree->Branch("Time_B", &fTimes_B);
+        }
+    }
+
+    if(fFeatureSettings.fIsEnabled)
+    {
+        fFeaturesTree = new TTree("lyso_features", "lyso_features");
+        SetFeaturesBranches(false);
+    }
+
+    if(fOutput.fIsSavingPhotons)
+    {
+        fPhotonsTree = new TTree("lyso_photons", "lyso_photons");
+        SetPhotonsBranches(false);
+        TNamed("PulseModel", fPulseModel.c_str()).Write("PulseModel", TObject::kOverwrite);
+        TParameter<Int_t>("NPulsePars", fNPulsePars).Write("NPulsePars", TObject::kOverwrite);
+        fIsRecordingPhotons = true;
+    }
+
+    ApplyOutputSettings();
+    OpenShm();
+    OpenOverlay();
+    if(isRNTuple)
+        OpenRNTuple();
+    if(isFlat)
+        OpenFlat();
+    return true;
+}
+
+
+
+void BarLYSO::OpenFlat()
+{
+    string base = fOutputFilename.substr(0, fOutputFilename.size() - 5);
+
+    fFlat = new FlatExporter();
+    if(!fFlat->Open(base, fChannels, fSamplings, fID, fOutput.fFlatChunkEvents, fDAQ->fSamplingSpeed, fDAQ->fIsBinSizeConstant))
+    {
+        cerr << "Can't create the flat binary files " << base << ".bin, writing the waveforms in the lyso_wfs tree" << endl;
+        delete fFlat;
+        fFlat = nullptr;
+
+        fOutTree = new TTree("lyso_wfs", "lyso_wfs");
+        fOutTree->Branch("Event", &fEvent);
+        fOutTree->Branch("Front", &fFront);
+        fOutTree->Branch("Back", &fBack);
+
+        fTimesTree = new TTree("lyso_wfs_times", "lyso_wfs_times");
+        fTimesTree->Branch("Time_F", &fTimes_F);
+        fTimesTree->Branch("Time_B", &fTimes_B);
+        return;
+    }
+
+    cout << "Writing the waveforms in " << base << ".json and its binary files" << endl;
+}
+
+
+
+void BarLYSO::OpenOverlay()
+{
+    if(fOverlayFilename.empty())
+        return;
+
+    fOverlay = new OverlayLibrary();
+    if(!fOverlay->Open(fOverlayFilename) || fOverlay->GetEvents() == 0
+       || (Int_t) fOverlay->GetChannels() != fChannels || (Int_t) fOverlay->GetSamplings() != fSamplings
+       || fOverlay->GetSamplingSpeed() != (Float_t) fDAQ->fSamplingSpeed)
+    {
+        cerr << "The overlay library " << fOverlayFilename << " doesn't match the geometry and sampling speed, no overlay" << endl;
+        delete fOverlay;
+        fOverlay = nullptr;
+        return;
+    }
+    if(!fDAQ->fIsBinSizeConstant)
+        cerr << "The overlay is shifted by whole samples, ignoring the bin size spread" << endl;
+    if(fOverlayWindow <= 0)
+        cerr << "Overlay window = 0: the overlaid events are added with no time shift" << endl;
+
+    cout << "Overlaying " << fOverlayEvents << " events of " << fOverlayFilename << " (" << fOverlay->GetEvents() << " events) on each event" << endl;
+}
+
+
+
+void BarLYSO::MixOverlay()
+{
+    const Double_t speed = fDAQ->fSamplingSpeed;
+    for(Int_t n = 0; n < fOverlayEvents; n++)
+    {
+        UInt_t event = fRandPars->Integer(fOverlay->GetEvents());
+        Int_t shift = (Int_t) lround(fRandPars->Uniform(-fOverlayWindow, fOverlayWindow) * speed);
+        if(abs(shift) >= fSamplings)
+            continue;
+
+        for(Int_t ch = 0; ch < fChannels; ch++)
+        {
+            if(!fFront[ch].empty())
+            {
+                ActivateChannel(true, ch);
+                fOverlay->AddShifted(event, 0, ch, shift, fFront[ch].data());
+            }
+            if(!fBack[ch].empty())
+            {
+                ActivateChannel(false, ch);
+                fOverlay->AddShifted(event, 1, ch, shift, fBack[ch].data());
+            }
+        }
+    }
+}
+
+
+
+void BarLYSO::LoadCalibration()
+{
+    fCalibration_F.clear();
+    fCalibration_B.clear();
+    if(fCalibrationFilename.empty())
+        return;
+
+    ChannelCalibration defaults = {fDAQ->ComputeFactorOfGainConversion(), BASELINE, fDAQ->fSigmaNoise};
+    Int_t nRead = LoadCalibrationTable(fCalibrationFilename, fChannels, fDAQ->fGain_Template, defaults, fCalibration_F, fCalibration_B);
+    if(nRead < 0)
+    {
+        cerr << "Using the global gain and noise for all the channels" << endl;
+        fCalibration_F.clear();
+        fCalibration_B.clear();
+        return;
+    }
+
+    cout << "Calibration of " << nRead << " channels from " << fCalibrationFilename << endl;
+}
+
+
+
+void BarLYSO::OpenRNTuple()
+{
+    fRNTuple = new RNTupleSink();
+    fRNTuple->Open(fOutFile, fOutFile->GetCompressionSettings());
+
+    cout << "Writing the waveforms in the lyso_wfs RNTuple of " << fOutputFilename << endl;
+}
+
+
+
+void BarLYSO::OpenShm()
+{
+    if(fOutput.fSink != "shm")
+        return;
+
+    // By default the segment is named after the output file
+    string name = fOutput.fShmName;
+    if(name.empty())
+    {
+        name = fOutputFilename.substr(fOutputFilename.find_last_of('/') + 1);
+        name = "/" + name.substr(0, name.size() - 5);
+    }
+
+    fShm = new ShmProducer();
+    if(!fShm->Open(name, fOutput.fShmSlots, fChannels, fSamplings))
+    {
+        cerr << "Can't create the shared-memory segment " << name << ", writing the waveforms to " << fOutputFilename << endl;
+        delete fShm;
+        fShm = nullptr;
+        return;
+    }
+
+    cout << "Publishing the waveforms to the shared-memory segment " << name << endl;
+}
+
+
+
+vector<TTree*> BarLYSO::GetOutputTrees() const
+{
+    vector<TTree*> trees;
+    for(TTree *tree : {fOutTree, fTimesTree, fFeaturesTree, fPhotonsTree})
+        if(tree) trees.push_back(tree);
+
+    return trees;
+}
+
+
+
+void BarLYSO::SetFeaturesBranches(Bool_t isRecovered)
+{
+    vector<pair<string, vector<Float_t>*>> floatBranches;
+    vector<pair<string, vector<Int_t>*>> intBranches;
+    for(auto side : {make_pair(string("_F"), &fFeatures_F), make_pair(string("_B"), &fFeatures_B)})
+    {
+        SideFeatures *f = side.second;
+        intBranches.push_back({"NPhotons" + side.first, &f->fNPhotons});
+        floatBranches.push_back({"FirstTime" + side.first, &f->fFirstTime});
+        floatBranches.push_back({"Baseline" + side.first, &f->fBaseline});
+        floatBranches.push_back({"Amplitude" + side.first, &f->fAmplitude});
+        floatBranches.push_back({"Charge" + side.first, &f->fCharge});
+        floatBranches.push_back({"PeakTime" + side.first, &f->fPeakTime});
+        floatBranches.push_back({"CFTime" + side.first, &f->fCFTime});
+    }
+
+    if(isRecovered)
+    {
+        // The branches are attached through a pointer to each container,
+        // kept until the tree is closed
+        fFeaturesIntPtrs.clear();
+        fFeaturesFloatPtrs.clear();
+        for(auto &b : intBranches) fFeaturesIntPtrs.push_back(b.second);
+        for(auto &b : floatBranches) fFeaturesFloatPtrs.push_back(b.second);
+
+        fFeaturesTree->SetBranchAddress("Event", &fEvent);
+        for(size_t i = 0; i < intBranches.size(); i++)
+            fFeaturesTree->SetBranchAddress(intBranches[i].first.c_str(), &fFeaturesIntPtrs[i]);
+        for(size_t i = 0; i < floatBranches.size(); i++)
+            fFeaturesTree->SetBranchAddress(floatBranches[i].first.c_str(), &fFeaturesFloatPtrs[i]);
+    }
+    else
+    {
+        fFeaturesTree->Branch("Event", &fEvent);
+        for(auto &b : intBranches) fFeaturesTree->Branch(b.first.c_str(), b.second);
+        for(auto &b : floatBranches) fFeaturesTree->Branch(b.first.c_str(), b.second);
+    }
+}
+
+
+
+void BarLYSO::SetPhotonsBranches(Bool_t isRecovered)
+{
+    if(isRecovered)
+    {
+        fPhotonsTree->SetBranchAddress("Event", &fEvent);
+        fPhotonsTree->SetBranchAddress("Ch_F", &fPhotonCh_FPtr);
+        fPhotonsTree->SetBranchAddress("T_F", &fPhotonT_FPtr);
+        fPhotonsTree->SetBranchAddress("Pars_F", &fPhotonPars_FPtr);
+        fPhotonsTree->SetBranchAddress("Ch_B", &fPhotonCh_BPtr);
+        fPhotonsTree->SetBranchAddress("T_B", &fPhotonT_BPtr);
+        fPhotonsTree->SetBranchAddress("Pars_B", &fPhotonPars_BPtr);
+    }
+    else
+    {
+        fPhotonsTree->Branch("Event", &fEvent);
+        fPhotonsTree->Branch("Ch_F", &fPhotonColumns_F.fChannel);
+        fPhotonsTree->Branch("T_F", &fPhotonColumns_F.fTime);
+        fPhotonsTree->Branch("Pars_F", &fPhotonColumns_F.fPars);
+        fPhotonsTree->Branch("Ch_B", &fPhotonColumns_B.fChannel);
+        fPhotonsTree->Branch("T_B", &fPhotonColumns_B.fTime);
+        fPhotonsTree->Branch("Pars_B", &fPhotonColumns_B.fPars);
+    }
+}
+
+
+
+void BarLYSO::ApplyOutputSettings()
+{
+    // Compression: the branches inherit it from the file when they are
+    // created, so set it on the branches too (for the recovered trees it only
+    // affects the baskets still to be written)
+    if(!fOutput.fCompressionAlgorithm.empty())
+    {
+        ROOT::RCompressionSetting::EAlgorithm::EValues algorithm;
+        if(fOutput.fCompressionAlgorithm == "ZLIB")
+            algorithm = ROOT::RCompressionSetting::EAlgorithm::kZLIB;
+        else if(fOutput.fCompressionAlgorithm == "LZMA")
+            algorithm = ROOT::RCompressionSetting::EAlgorithm::kLZMA;
+        else if(fOutput.fCompressionAlgorithm == "LZ4")
+            algorithm = ROOT::RCompressionSetting::EAlgorithm::kLZ4;
+        else if(fOutput.fCompressionAlgorithm == "ZSTD")
+            algorithm = ROOT::RCompressionSetting::EAlgorithm::kZSTD;
+        else
+        {
+            cerr << "Unknown compression algorithm " << fOutput.fCompressionAlgorithm << ", using the ROOT default" << endl;
+            algorithm = ROOT::RCompressionSetting::EAlgorithm::kUseGlobal;
+        }
+
+        Int_t level = (fOutput.fCompressionLevel < 0) ? 4 : fOutput.fCompressionLevel;
+        Int_t settings = ROOT::CompressionSettings(algorithm, level);
+        fOutFile->SetCompressionSettings(settings);
+        for(TTree *tree : GetOutputTrees())
+        {
+            TObjArray *branches = tree->GetListOfBranches();
+            for(Int_t i = 0; i < branches->GetEntriesFast(); i++)
+                static_cast<TBranch*>(branches->UncheckedAt(i))->SetCompressionSettings(settings);
+        }
+    }
+
+    // Basket sizes: first the default for all branches, then the specific ones
+    auto all = fOutput.fBasketSizes.find("*");
+    if(all != fOutput.fBasketSizes.end())
+    {
+        for(TTree *tree : GetOutputTrees())
+            tree->SetBasketSize("*", all->second);
+    }
+    for(const auto &basket : fOutput.fBasketSizes)
+    {
+        if(basket.first == "*")
+            continue;
+        Bool_t isFound = false;
+        for(TTree *tree : GetOutputTrees())
+        {
+            if(tree->GetBranch(basket.first.c_str()))
+            {
+                tree->SetBasketSize(basket.first.c_str(), basket.second);
+                isFound = true;
+            }
+        }
+        if(!isFound)
+            cerr << "No branch " << basket.first << " in the output trees, basket size ignored" << endl;
+    }
+
+    // Memory cap: scale down the baskets and keep the clusters within the cap
+    Long64_t autoFlush = fOutput.fAutoFlush;
+    if(fOutput.fMemoryCap > 0 && fOutTree)
+    {
+        TObjArray *branches = fOutTree->GetListOfBranches();
+        Long64_t totBasketSize = 0;
+        for(Int_t i = 0; i < branches->GetEntriesFast(); i++)
+            totBasketSize += static_cast<TBranch*>(branches->UncheckedAt(i))->GetBasketSize();
+
+        if(totBasketSize > fOutput.fMemoryCap)
+        {
+            Double_t scale = (Double_t) fOutput.fMemoryCap / totBasketSize;
+            for(Int_t i = 0; i < branches->GetEntriesFast(); i++)
+            {
+                auto *branch = static_cast<TBranch*>(branches->UncheckedAt(i));
+                branch->SetBasketSize(TMath::Max(1, TMath::Nint(scale * branch->GetBasketSize())));
+            }
+        }
+
+        // A cluster of N entries holds about N uncompressed events
+        Long64_t eventBytes = 2LL * fChannels * fSamplings * sizeof(Float_t);
+        Long64_t maxEntries = TMath::Max(1LL, fOutput.fMemoryCap / eventBytes);
+        if(autoFlush == 0 || autoFlush < -fOutput.fMemoryCap)
+            autoFlush = -fOutput.fMemoryCap;
+        else if(autoFlush > maxEntries)
+            autoFlush = maxEntries;
+    }
+
+    // Auto-flush and auto-save
+    if(autoFlush != 0 && fOutTree)
+        fOutTree->SetAutoFlush(autoFlush);
+    if(fOutput.fAutoSave != 0 && fOutTree)
+        fOutTree->SetAutoSave(fOutput.fAutoSave);
+    if(fFeaturesTree && fOutput.fAutoFlush != 0)
+        fFeaturesTree->SetAutoFlush(fOutput.fAutoFlush);
+}
+
+
+
+Long64_t BarLYSO::GetBasketMemory() const
+{
+    Long64_t memory = 0;
+    for(TTree *tree : GetOutputTrees())
+    {
+        TObjArray *branches = tree->GetListOfBranches();
+        for(Int_t i = 0; i < branches->GetEntriesFast(); i++)
+            memory += static_cast<TBranch*>(branches->UncheckedAt(i))->GetBasketSize();
+    }
+
+    return memory;
+}
+
+
+
+void BarLYSO::PrintIOReport()
+{
+    if(!fOutFile)
+        return;
+
+    string prefix = (fThreadID == -1) ? "BarST>> " : "BarWT" + to_string(fThreadID) + ">> ";
+
+    cout << prefix << "Output file " << fOutputFilename << ": " << fOutFile->GetEND() / 1.e6 << " MB" << endl;
+    if(fOutput.fSink == "shm")
+        cout << prefix << "  " << fShmFallbacks << " events written to the file because the shared-memory ring was full" << endl;
+    if(fRNTuple)
+        cout << prefix << "  lyso_wfs RNTuple: " << fRNTuple->GetEntries() << " events" << endl;
+    if(fFlat)
+        cout << prefix << "  Flat binary files: " << fFlat->GetEntries() << " events, " << fFlat->GetBytesWritten() / 1.e6 << " MB" << endl;
+    for(TTree *tree : GetOutputTrees())
+    {
+        TObjArray *branches = tree->GetListOfBranches();
+        for(Int_t i = 0; i < branches->GetEntriesFast(); i++)
+        {
+            auto *branch = static_cast<TBranch*>(branches->UncheckedAt(i));
+            Long64_t totBytes = branch->GetTotBytes("*");
+            Long64_t zipBytes = branch->GetZipBytes("*");
+            cout << prefix << "  " << tree->GetName() << "/" << branch->GetName() << ": "
+                 << zipBytes / 1.e6 << " MB written, compression ratio "
+                 << ((zipBytes > 0) ? (Double_t) totBytes / zipBytes : 0.) << endl;
+        }
+    }
+}
 
-    fTimesTree = new TTree("lyso_wfs_times", "lyso_wfs_times");
-    fTimesTree->Branch("Time_F", &fTimes_F);
-    fTimesTree->Branch("Time_B", &fTimes_B);
+
+
+Bool_t BarLYSO::RecoverCheckpoint()
+{
+    fOutTree = fOutFile->Get<TTree>("lyso_wfs");
+    fTimesTree = fOutFile->Get<TTree>("lyso_wfs_times");
+    unique_ptr<TParameter<Long64_t>> progress(fOutFile->Get<TParameter<Long64_t>>("Progress"));
+    unique_ptr<TRandom3> randPars(fOutFile->Get<TRandom3>("RandPars"));
+    unique_ptr<TRandom3> randNoise(fOutFile->Get<TRandom3>("RandNoise"));
+
+    if(!fOutTree || !fTimesTree || !progress || !randPars || !randNoise || fTimesTree->GetEntries() == 0)
+        return false;
+
+    if(fFeatureSettings.fIsEnabled)
+    {
+        fFeaturesTree = fOutFile->Get<TTree>("lyso_features");
+        if(!fFeaturesTree || fFeaturesTree->GetEntries() != fOutTree->GetEntries())
+            return false;
+        SetFeaturesBranches(true);
+    }
+    if(fOutput.fIsSavingPhotons)
+    {
+        fPhotonsTree = fOutFile->Get<TTree>("lyso_photons");
+        if(!fPhotonsTree || fPhotonsTree->GetEntries() != fOutTree->GetEntries())
+            return false;
+        SetPhotonsBranches(true);
+        fIsRecordingPhotons = true;
+    }
+
+    // Reattach the branches to the containers
+    fOutTree->SetBranchAddress("Event", &fEvent);
+    fOutTree->SetBranchAddress("Front", &fFrontPtr);
+    fOutTree->SetBranchAddress("Back", &fBackPtr);
+    if(IsJitterPool())
+    {
+        if(!fTimesTree->GetBranch("Time_Pool") || !fOutTree->GetBranch("TimeIdx_F"))
+            return false;
+        fOutTree->SetBranchAddress("TimeIdx_F", &fTimeIdx_FPtr);
+        fOutTree->SetBranchAddress("TimeIdx_B", &fTimeIdx_BPtr);
+        fTimesTree->SetBranchAddress("Time_Pool", &fTimePoolPtr);
+    }
+    else
+    {
+        fTimesTree->SetBranchAddress("Time_F", &fTimes_FPtr);
+        fTimesTree->SetBranchAddress("Time_B", &fTimes_BPtr);
+    }
+
+    // The sampling times (or their pool) are the same for the whole run
+    fTimesTree->GetEntry(0);
+    InitResampler();
+    LoadCalibration();
+
+    // Continue the random sequences from where they were saved
+    delete fRandPars;
+    delete fRandNoise;
+    fRandPars = randPars.release();
+    fRandNoise = randNoise.release();
+
+    // The entries of the tree are those safely on disk (the skipped events
+    // have none, and with another sink only the fallback events are there:
+    // the progress record counts them)
+    fResumeEntry = fOutTree->GetEntries();
+    if(fFilter.IsSelectingEvents() || fOutput.fSink != "file")
+        fResumeEntry = progress->GetVal() + 1;
+    else if(progress->GetVal() + 1 != fResumeEntry)
+        cerr << "Progress record out of sync with " << fOutputFilename << ": the random sequences are not continued exactly" << endl;
+    fLastEntry = fResumeEntry - 1;
+
+    cout << "Resuming " << fOutputFilename << " from entry " << fResumeEntry << endl;
+
+    return true;
+}
+
+
+
+void BarLYSO::WriteProgress(Long64_t entry)
+{
+    TParameter<Long64_t> progress("Progress", entry);
+    fOutFile->WriteTObject(&progress, "Progress", "Overwrite");
+    fOutFile->WriteTObject(fRandPars, "RandPars", "Overwrite");
+    fOutFile->WriteTObject(fRandNoise, "RandNoise", "Overwrite");
+}
+
+
+
+void BarLYSO::Checkpoint(Long64_t entry)
+{
+    fLastEntry = entry;
+    if(!fOutFile || fRNTuple || fFlat || fOutput.fCheckpointEvents <= 0 || (entry + 1) % fOutput.fCheckpointEvents != 0)
+        return;
+
+    TraceScope scope("checkpoint", entry);
+
+    // The trees first, then the progress record: after a crash in between
+    // the record is behind the trees, never ahead of them
+    for(TTree *tree : GetOutputTrees())
+        tree->AutoSave("SaveSelf");
+    WriteProgress(entry);
+    fOutFile->SaveSelf(kTRUE);
 }
 
 
@@ -52,6 +757,23 @@ BarLYSO::~BarLYSO()
     delete hPars;
     delete fRandPars;
     delete fRandNoise;
+    delete fResampler;
+
+    CloseOutput();
+}
+
+
+
+void BarLYSO::CloseOutput()
+{
+    delete fShm;
+    delete fRNTuple;
+    delete fFlat;
+    delete fOverlay;
+    fShm = nullptr;
+    fRNTuple = nullptr;
+    fFlat = nullptr;
+    fOverlay = nullptr;
 
     // Ensure that we delete the TTree and TFile objects only if they are not null
     if(fOutTree)
@@ -64,11 +786,45 @@ BarLYSO::~BarLYSO()
         fTimesTree->ResetBranchAddresses();  // Reset any attached branches if needed
         delete fTimesTree;
     }
+    if(fFeaturesTree)
+    {
+        fFeaturesTree->ResetBranchAddresses();
+        delete fFeaturesTree;
+    }
+    if(fPhotonsTree)
+    {
+        fPhotonsTree->ResetBranchAddresses();
+        delete fPhotonsTree;
+    }
     if(fOutFile)
     {
         fOutFile->Close(); // Make sure to close the file properly
         delete fOutFile;
     }
+    fOutTree = nullptr;
+    fTimesTree = nullptr;
+    fFeaturesTree = nullptr;
+    fPhotonsTree = nullptr;
+    fOutFile = nullptr;
+    fResumeEntry = 0;
+    fLastEntry = -1;
+    fShmFallbacks = 0;
+}
+
+
+
+void BarLYSO::SetMCFilename(const char *mcFilename)
+{
+    fOutputFilename = GenerateOutputFilename(mcFilename);
+}
+
+
+
+void BarLYSO::SetSeed(UInt_t seed)
+{
+    fRandPars->SetSeed(seed);
+    fRandNoise->SetSeed(seed + 1);
+    fDAQ->binRand->SetSeed(seed + 2);
 }
 
 
@@ -77,6 +833,7 @@ string BarLYSO::GenerateOutputFilename(const char* inputFilename)
 {
     // Regular expression to extract digits following "MCID_"
     regex regex("\\bMCID_(\\d+)");
+    fID = 0;
 
     // Storage for matched results
     smatch match;
@@ -123,43 +880,95 @@ string BarLYSO::GenerateOutputFilename(const char* inputFilename)
 
 void BarLYSO::SetSamplingTimes()
 {
-    // Set the times
-    for(Int_t j = 0; j < CHANNELS; j++)
+    // Per-event grids: a pool drawn once, assigned by InitializeBaselines()
+    fTimePool.clear();
+    if(IsJitterPool())
     {
-        if(fDAQ->fIsBinSizeConstant)
+        if(fDAQ->fJitterPool > JITTER_POOL_MAX)
         {
-            for(Int_t i = 0; i < SAMPLINGS; i++)
-            {
-                fTimes_F[j][i] = (Float_t) i / fDAQ->fSamplingSpeed;
-                fTimes_B[j][i] = (Float_t) i / fDAQ->fSamplingSpeed;
-            }
+            cerr << "Jitter pool of " << fDAQ->fJitterPool << " grids, using " << JITTER_POOL_MAX << endl;
+            fDAQ->fJitterPool = JITTER_POOL_MAX;
         }
-        else
+        fTimePool.assign(fDAQ->fJitterPool, vector<Float_t>(fSamplings, 0));
+        for(vector<Float_t> &grid : fTimePool)
         {
-            // Initialize the first time points
-            fTimes_F[j][0] = 0.0;
-            fTimes_B[j][0] = 0.0;
-
-            for(Int_t i = 0; i < SAMPLINGS - 1; i++)  // Up to SAMPLINGS - 1
+            for(Int_t i = 0; i < fSamplings - 1; i++)
+                grid[i+1] = grid[i] + DrawBinSize();
+        }
+        AssignPoolTimes(fEvent);
+    }
+    else
+    {
+        // One grid for the whole run
+        for(Int_t j = 0; j < fChannels; j++)
+        {
+            if(fDAQ->fIsBinSizeConstant)
             {
-                Float_t bin_F, bin_B;
-                do
+                for(Int_t i = 0; i < fSamplings; i++)
                 {
-                    bin_F = fDAQ->binRand->Gaus(1.0 / fDAQ->fSamplingSpeed, fDAQ->fSigmaBinSize);
-                } while (bin_F < 0.5 * (1.0 / fDAQ->fSamplingSpeed) || bin_F > 1.5 * (1.0 / fDAQ->fSamplingSpeed));
+                    fTimes_F[j][i] = (Float_t) i / fDAQ->fSamplingSpeed;
+                    fTimes_B[j][i] = (Float_t) i / fDAQ->fSamplingSpeed;
+                }
+            }
+            else
+            {
+                // Initialize the first time points
+                fTimes_F[j][0] = 0.0;
+                fTimes_B[j][0] = 0.0;
 
-                do
+                for(Int_t i = 0; i < fSamplings - 1; i++)  // Up to fSamplings - 1
                 {
-                    bin_B = fDAQ->binRand->Gaus(1.0 / fDAQ->fSamplingSpeed, fDAQ->fSigmaBinSize);
-                } while (bin_B < 0.5 * (1.0 / fDAQ->fSamplingSpeed) || bin_B > 1.5 * (1.0 / fDAQ->fSamplingSpeed));
+                    Float_t bin_F = DrawBinSize();
+                    Float_t bin_B = DrawBinSize();
 
-                fTimes_F[j][i+1] = fTimes_F[j][i] + bin_F;
-                fTimes_B[j][i+1] = fTimes_B[j][i] + bin_B;
+                    fTimes_F[j][i+1] = fTimes_F[j][i] + bin_F;
+                    fTimes_B[j][i+1] = fTimes_B[j][i] + bin_B;
+                }
             }
         }
     }
 
-    fTimesTree->Fill();
+    if(fTimesTree)
+        fTimesTree->Fill();
+    if(fShm)
+        fShm->SetTimes(fTimes_F, fTimes_B);
+    if(fRNTuple)
+        fRNTuple->SetTimes(fTimes_F, fTimes_B);
+    if(fFlat)
+        fFlat->SetTimes(fTimes_F, fTimes_B);
+
+    InitResampler();
+    LoadCalibration();
+}
+
+
+
+Float_t BarLYSO::DrawBinSize()
+{
+    Float_t bin;
+    do
+    {
+        bin = fDAQ->binRand->Gaus(1.0 / fDAQ->fSamplingSpeed, fDAQ->fSigmaBinSize);
+    } while (bin < 0.5 * (1.0 / fDAQ->fSamplingSpeed) || bin > 1.5 * (1.0 / fDAQ->fSamplingSpeed));
+
+    return bin;
+}
+
+
+
+void BarLYSO::AssignPoolTimes(Int_t event)
+{
+    const ULong64_t pool = fTimePool.size();
+    fTimeIdx_F.resize(fChannels);
+    fTimeIdx_B.resize(fChannels);
+
+    // The event number is the key: no random sequence to keep in sync
+    for(Int_t ch = 0; ch < fChannels; ch++)
+    {
+        ULong64_t key = ((ULong64_t) (UInt_t) event << 32) | (2 * (UInt_t) ch);
+        fTimeIdx_F[ch] = MixKey(key) % pool;
+        fTimeIdx_B[ch] = MixKey(key | 1) % pool;
+    }
 }
 
 
@@ -175,6 +984,43 @@ void BarLYSO::SetParsDistro()
  
     tree->SetBranchAddress("Status", &status);
     tree->SetBranchAddress("Charge", &charge);
+
+    // Models other than 2exp: keep the accepted rows, resampled as a whole
+    if(fPulseModel != TwoExpPulse::kName)
+    {
+        Double_t pars[MAX_PULSE_PARS];
+        Bool_t isComplete = true;
+        for(Int_t p = 0; p < fNPulsePars && isComplete; p++)
+        {
+            isComplete = tree->GetBranch(fPulseColumns[p]) != nullptr;
+            if(isComplete)
+                tree->SetBranchAddress(fPulseColumns[p], &pars[p]);
+            else
+                cerr << "No column " << fPulseColumns[p] << " in " << fInputFilename << endl;
+        }
+
+        fPulseRows.clear();
+        for(Int_t i = 0; isComplete && i < tree->GetEntries(); i++)
+        {
+            tree->GetEntry(i);
+            if(status==0 && charge >= fChargeCuts[0] && charge <= fChargeCuts[1])
+                fPulseRows.insert(fPulseRows.end(), pars, pars + fNPulsePars);
+        }
+
+        if(!fPulseRows.empty())
+        {
+            delete tree;
+            if(fApproxThreshold > 0)
+                BuildApproxPulse();
+            return;
+        }
+        cerr << "No parameters of the " << fPulseModel << " pulse model, using " << TwoExpPulse::kName << endl;
+        tree->ResetBranchAddresses();
+        tree->SetBranchAddress("Status", &status);
+        tree->SetBranchAddress("Charge", &charge);
+        SetPulseModel(TwoExpPulse::kName);
+    }
+
     tree->SetBranchAddress("A", &A);
     tree->SetBranchAddress("Tau_rise", &tau_rise);
     tree->SetBranchAddress("Tau_fall", &tau_dec);
@@ -196,23 +1042,18 @@ void BarLYSO::SetParsDistro()
  
     // Delete the TTree
     delete tree;
+
+    // The table of the approximation, before any event
+    if(fApproxThreshold > 0)
+        BuildApproxPulse();
 }
 
 
 
 Float_t BarLYSO::Wave_OnePhel(Float_t t, Double_t A, Double_t tau_rise, Double_t tau_dec, Double_t timePhel)
 {
-    Float_t funcVal;
-    Double_t expRise = Exp(-(t-timePhel)/tau_rise);
-    Double_t expDec = Exp(-(t-timePhel)/tau_dec);
-
-    // 1-Phel function
-    funcVal = static_cast<Float_t>(A*(expRise-expDec)*((t > timePhel) ? 1:0));
-    
-    // Numerical fixing
-    if(funcVal > 0 || IsNaN(funcVal)) funcVal = 0;
-    
-    return funcVal;
+    const Double_t pars[TwoExpPulse::kNPars] = {A, tau_rise, tau_dec};
+    return TwoExpPulse::Eval(t, pars, timePhel);
 }
 
 
@@ -220,78 +1061,450 @@ Float_t BarLYSO::Wave_OnePhel(Float_t t, Double_t A, Double_t tau_rise, Double_t
 void BarLYSO::InitializeBaselines(Int_t event)
 {
     fEvent = event;
-    fFront.assign(CHANNELS, std::vector<Float_t>(SAMPLINGS, 0.));
-    fBack.assign(CHANNELS, std::vector<Float_t>(SAMPLINGS, 0.));
+
+    // The masked channels stay empty; the buffers of the previous event are
+    // reused without a reset, each channel is zeroed by ActivateChannel()
+    // when it receives a signal and the others are written with the noise
+    fFront.resize(fChannels);
+    fBack.resize(fChannels);
+    for(Int_t ch = 0; ch < fChannels; ch++)
+    {
+        fFront[ch].resize(fMask_F[ch] ? fSamplings : 0);
+        fBack[ch].resize(fMask_B[ch] ? fSamplings : 0);
+    }
+    fActive_F.assign(fChannels, false);
+    fActive_B.assign(fChannels, false);
+    if(fSiPMNoise.IsEnabled())
+        fAvalanches.resize(fChannels);
+    if(!fTimePool.empty())
+        AssignPoolTimes(event);
+
+    if(fFeatureSettings.fIsEnabled)
+    {
+        fFeatures_F.ResetTruth();
+        fFeatures_B.ResetTruth();
+    }
+
+    fPhotons_F.clear();
+    fPhotons_B.clear();
 }
 
 
 
 void BarLYSO::ClearContainers()
 {
-    for(Int_t ch = 0; ch < CHANNELS; ch++)
+    // The buffers are kept for the next event, with their stale samples
+    fActive_F.assign(fChannels, false);
+    fActive_B.assign(fChannels, false);
+}
+
+
+
+template<class Geo, class Pulse>
+void BarLYSO::AddOnePhelKernel(vector<Float_t> &wave, const vector<Float_t> &times, const Double_t *pars, Double_t start)
+{
+    const Int_t samplings = Geo::kIsGeneric ? (Int_t) wave.size() : Geo::kSamplings;
+    Float_t *w = wave.data();
+    const Float_t *t = times.data();
+
+    // Evaluate and sum the new 1-Phel WF to the existing one
+    for(Int_t bin = 0; bin < samplings; bin++)
     {
-        fFront[ch].clear();
-        fBack[ch].clear();
+        w[bin] += Pulse::Eval(t[bin], pars, start + ZERO_TIME_BIN);
     }
-
-    fFront.clear();
-    fBack.clear();
 }
 
 
 
 void BarLYSO::SetFrontWaveform(Int_t channel, Double_t start)
 {
-    // Sample from hPars the parameters of 1-Phel WF
-    Double_t A, tau_rise, tau_dec;
-    hPars->GetRandom3(A, tau_rise, tau_dec, fRandPars);
-    
-    // Evaluate and sum the new 1-Phel WF to the existing one
-    for(Int_t bin = 0; bin < SAMPLINGS; bin++)
+    if(!IsValidChannel(channel) || !fMask_F[channel])
+        return;
+
+    // Sample the parameters of 1-Phel WF
+    Double_t pars[MAX_PULSE_PARS];
+    SamplePulsePars(pars);
+
+    if(fFeatureSettings.fIsEnabled)
+        fFeatures_F.AddPhoton(channel, start);
+    if(fIsRecordingPhotons)
     {
-        fFront[channel][bin] += Wave_OnePhel(fTimes_F[channel][bin], A, tau_rise, tau_dec, start + ZERO_TIME_BIN);
+        Photon photon;
+        photon.fChannel = channel;
+        photon.fTime = start;
+        copy_n(pars, fNPulsePars, photon.fPars);
+        fPhotons_F.push_back(photon);
     }
+    
+    AddFrontPhel(channel, pars, start);
 }
 
 
 
 void BarLYSO::SetBackWaveform(Int_t channel, Double_t start)
 {
-    // Sample from hPars the parameters of 1-Phel WF
-    Double_t A, tau_rise, tau_dec;
-    hPars->GetRandom3(A, tau_rise, tau_dec, fRandPars);
+    if(!IsValidChannel(channel) || !fMask_B[channel])
+        return;
+
+    // Sample the parameters of 1-Phel WF
+    Double_t pars[MAX_PULSE_PARS];
+    SamplePulsePars(pars);
+
+    if(fFeatureSettings.fIsEnabled)
+        fFeatures_B.AddPhoton(channel, start);
+    if(fIsRecordingPhotons)
+    {
+        Photon photon;
+        photon.fChannel = channel;
+        photon.fTime = start;
+        copy_n(pars, fNPulsePars, photon.fPars);
+        fPhotons_B.push_back(photon);
+    }
     
-    // Evaluate and sum the new 1-Phel WF to the existing one
-    for(Int_t bin = 0; bin < SAMPLINGS; bin++)
+    AddBackPhel(channel, pars, start);
+}
+
+
+
+Bool_t BarLYSO::WarnChannel(Int_t channel)
+{
+    if(!fIsChannelWarned)
     {
-        fBack[channel][bin] += Wave_OnePhel(fTimes_B[channel][bin], A, tau_rise, tau_dec, start + ZERO_TIME_BIN);
+        cerr << "Channel " << channel << " of the MC input is out of the " << fChannels << " channels of the detector: its photons are skipped" << endl;
+        fIsChannelWarned = true;
     }
+    return false;
 }
 
 
 
-void BarLYSO::SaveEvent()
-{   
-    // Recompute the gain and add noise
-    Float_t k = fDAQ->ComputeFactorOfGainConversion();
-    for(Int_t ch = 0; ch < CHANNELS; ch++)
+Bool_t BarLYSO::HasSameSampling(const BarLYSO &other) const
+{
+    if(fChannels != other.fChannels || fSamplings != other.fSamplings)
+        return false;
+    if(fDAQ->fSamplingSpeed != other.fDAQ->fSamplingSpeed || fDAQ->fIsBinSizeConstant != other.fDAQ->fIsBinSizeConstant)
+        return false;
+    if(fDAQ->fSamplingSpeed_Synthesis != other.fDAQ->fSamplingSpeed_Synthesis)
+        return false;
+    if((IsJitterPool() ? fDAQ->fJitterPool : 0) != (other.IsJitterPool() ? other.fDAQ->fJitterPool : 0))
+        return false;
+
+    return fDAQ->fIsBinSizeConstant || fDAQ->fSigmaBinSize == other.fDAQ->fSigmaBinSize;
+}
+
+
+
+void BarLYSO::CopySamplingTimes(const BarLYSO &other)
+{
+    fTimes_F = other.fTimes_F;
+    fTimes_B = other.fTimes_B;
+    fTimePool = other.fTimePool;
+
+    if(fTimesTree)
+        fTimesTree->Fill();
+    if(fShm)
+        fShm->SetTimes(fTimes_F, fTimes_B);
+    if(fRNTuple)
+        fRNTuple->SetTimes(fTimes_F, fTimes_B);
+    if(fFlat)
+        fFlat->SetTimes(fTimes_F, fTimes_B);
+
+    InitResampler();
+    LoadCalibration();
+}
+
+
+
+void BarLYSO::InitResampler()
+{
+    delete fResampler;
+    fResampler = nullptr;
+    fFineTimes.clear();
+    fFine_F.clear();
+    fFine_B.clear();
+
+    // A negative synthesis rate stands for the rate of the template data
+    Float_t rate = (fDAQ->fSamplingSpeed_Synthesis < 0) ? fDAQ->fSamplingSpeed_Template : fDAQ->fSamplingSpeed_Synthesis;
+    if(rate > 0 && rate != fDAQ->fSamplingSpeed)
     {
-        for(Int_t bin = 0; bin < SAMPLINGS; bin++)
+        if(IsFreeRunning())
+            cerr << "The free-running mode synthesizes at the sampling speed, the synthesis rate is ignored" << endl;
+        else
         {
-            // Set every bin with gaussian noise
-            fFront[ch][bin] = k*fFront[ch][bin] + Add_Noise();
-            fBack[ch][bin] = k*fBack[ch][bin] + Add_Noise();
+            fResampler = new Resampler();
+            if(!fResampler->Init(rate, fDAQ->fSamplingSpeed, fSamplings))
+            {
+                cerr << "The synthesis rate " << rate << " GSPS is not a simple fraction of the sampling speed " << fDAQ->fSamplingSpeed << " GSPS, synthesizing at the sampling times" << endl;
+                delete fResampler;
+                fResampler = nullptr;
+            }
         }
     }
 
-    fOutTree->Fill();
+    if(fResampler)
+    {
+        Int_t length = fResampler->GetInputLength();
+        fFineTimes.resize(length);
+        for(Int_t i = 0; i < length; i++)
+            fFineTimes[i] = (Float_t) fResampler->GetInputTime(i);
+        fFine_F.assign(fChannels, vector<Float_t>(length, 0));
+        fFine_B.assign(fChannels, vector<Float_t>(length, 0));
+        fIsFineUsed_F.assign(fChannels, false);
+        fIsFineUsed_B.assign(fChannels, false);
+        cout << "Synthesizing at " << rate << " GSPS, resampled to " << fDAQ->fSamplingSpeed << " GSPS" << endl;
+    }
+
+    // The synthesis grid has its own length
+    SelectKernels();
+}
+
+
+
+void BarLYSO::ResampleWaveforms(Bool_t isFront)
+{
+    vector<vector<Float_t>> &fine = isFront ? fFine_F : fFine_B;
+    vector<Char_t> &isUsed = isFront ? fIsFineUsed_F : fIsFineUsed_B;
+    vector<vector<Float_t>> &waves = isFront ? fFront : fBack;
+
+    for(Int_t ch = 0; ch < fChannels; ch++)
+    {
+        if(!isUsed[ch])
+            continue;
+
+        if(fDAQ->fIsBinSizeConstant)
+            fResampler->Process(fine[ch].data(), waves[ch].data());
+        else
+            fResampler->ProcessAt(fine[ch].data(), GetChannelTimes(isFront, ch).data(), waves[ch].data());
+
+        fill(fine[ch].begin(), fine[ch].end(), 0);
+        isUsed[ch] = false;
+    }
+}
+
+
+
+void BarLYSO::CopyWaveforms(const BarLYSO &other)
+{
+    // Only the channels with a signal: the others are written with the noise
+    for(Int_t ch = 0; ch < fChannels; ch++)
+    {
+        fActive_F[ch] = other.fActive_F[ch];
+        fActive_B[ch] = other.fActive_B[ch];
+        if(fActive_F[ch]) fFront[ch] = other.fFront[ch];
+        if(fActive_B[ch]) fBack[ch] = other.fBack[ch];
+    }
+
+    if(fFeatureSettings.fIsEnabled)
+    {
+        for(const Photon &ph : other.fPhotons_F) fFeatures_F.AddPhoton(ph.fChannel, ph.fTime);
+        for(const Photon &ph : other.fPhotons_B) fFeatures_B.AddPhoton(ph.fChannel, ph.fTime);
+    }
+}
+
+
+
+void BarLYSO::SynthesizeFrom(const BarLYSO &other)
+{
+    SynthesizePhotons(other.fPhotons_F, other.fPhotons_B, other.fPulseModel);
+}
+
+
+
+void BarLYSO::SynthesizePhotons(const vector<Photon> &photons_F, const vector<Photon> &photons_B, const string &pulseModel)
+{
+    // With another pulse model only the arrival times are shared
+    Bool_t isSameModel = (fPulseModel == pulseModel);
+    Double_t pars[MAX_PULSE_PARS];
+
+    for(const Photon &ph : photons_F)
+    {
+        if(!IsValidChannel(ph.fChannel) || !fMask_F[ph.fChannel])
+            continue;
+        if(fFeatureSettings.fIsEnabled)
+            fFeatures_F.AddPhoton(ph.fChannel, ph.fTime);
+        if(isSameModel)
+            copy_n(ph.fPars, fNPulsePars, pars);
+        else
+            SamplePulsePars(pars);
+        if(fIsRecordingPhotons)
+        {
+            Photon photon;
+            photon.fChannel = ph.fChannel;
+            photon.fTime = ph.fTime;
+            copy_n(pars, fNPulsePars, photon.fPars);
+            fPhotons_F.push_back(photon);
+        }
+        AddFrontPhel(ph.fChannel, pars, ph.fTime);
+    }
+
+    for(const Photon &ph : photons_B)
+    {
+        if(!IsValidChannel(ph.fChannel) || !fMask_B[ph.fChannel])
+            continue;
+        if(fFeatureSettings.fIsEnabled)
+            fFeatures_B.AddPhoton(ph.fChannel, ph.fTime);
+        if(isSameModel)
+            copy_n(ph.fPars, fNPulsePars, pars);
+        else
+            SamplePulsePars(pars);
+        if(fIsRecordingPhotons)
+        {
+            Photon photon;
+            photon.fChannel = ph.fChannel;
+            photon.fTime = ph.fTime;
+            copy_n(pars, fNPulsePars, photon.fPars);
+            fPhotons_B.push_back(photon);
+        }
+        AddBackPhel(ph.fChannel, pars, ph.fTime);
+    }
+
+    if(fSiPMNoise.IsEnabled())
+    {
+        for(const Photon &ph : photons_F)
+        {
+            if(IsValidChannel(ph.fChannel))
+                fAvalanches[ph.fChannel].push_back(ph.fTime);
+        }
+        AddSiPMNoise(true);
+        for(const Photon &ph : photons_B)
+        {
+            if(IsValidChannel(ph.fChannel))
+                fAvalanches[ph.fChannel].push_back(ph.fTime);
+        }
+        AddSiPMNoise(false);
+    }
+
+    if(fResampler)
+    {
+        ResampleWaveforms(true);
+        ResampleWaveforms(false);
+    }
+}
+
+
+
+template<class Geo>
+void BarLYSO::DigitizeKernel()
+{
+    const Int_t channels = Geo::kIsGeneric ? fChannels : Geo::kChannels;
+    const Int_t samplings = Geo::kIsGeneric ? fSamplings : Geo::kSamplings;
+
+    // Gain, baseline and noise of each channel (the global ones without a
+    // calibration table) and clipping of the ADC, in a single pass
+    const ChannelCalibration global = {fDAQ->ComputeFactorOfGainConversion(), BASELINE, fDAQ->fSigmaNoise};
+    const Bool_t isCalibrated = !fCalibration_F.empty();
+    const Float_t *range = fDAQ->fADCRange;
+    for(Int_t ch = 0; ch < channels; ch++)
+    {
+        const ChannelCalibration &cal_F = isCalibrated ? fCalibration_F[ch] : global;
+        const ChannelCalibration &cal_B = isCalibrated ? fCalibration_B[ch] : global;
+        Float_t *front = fFront[ch].data();
+        Float_t *back = fBack[ch].data();
+        Bool_t isFront = !fFront[ch].empty(), isBack = !fBack[ch].empty();
+        if(isFront && isBack && fActive_F[ch] && fActive_B[ch])
+        {
+            for(Int_t bin = 0; bin < samplings; bin++)
+            {
+                front[bin] = DigitizeSample(front[bin], cal_F, range);
+                back[bin] = DigitizeSample(back[bin], cal_B, range);
+            }
+        }
+        else if(isFront && isBack)
+        {
+            // Channels without signal are written straight from the noise
+            // generator, in the same order
+            for(Int_t bin = 0; bin < samplings; bin++)
+            {
+                front[bin] = fActive_F[ch] ? DigitizeSample(front[bin], cal_F, range) : NoiseSample(cal_F, range);
+                back[bin] = fActive_B[ch] ? DigitizeSample(back[bin], cal_B, range) : NoiseSample(cal_B, range);
+            }
+        }
+        else
+        {
+            // Masked channels are empty
+            for(Int_t bin = 0; isFront && bin < samplings; bin++)
+                front[bin] = fActive_F[ch] ? DigitizeSample(front[bin], cal_F, range) : NoiseSample(cal_F, range);
+            for(Int_t bin = 0; isBack && bin < samplings; bin++)
+                back[bin] = fActive_B[ch] ? DigitizeSample(back[bin], cal_B, range) : NoiseSample(cal_B, range);
+        }
+
+        // Extract the features while the channel is still in cache
+        if(fFeatureSettings.fIsEnabled)
+        {
+            if(isFront)
+                ExtractFeatures(front, GetChannelTimes(true, ch).data(), samplings, fFeatureSettings, fFeatures_F, ch);
+            else
+                fFeatures_F.ClearEstimators(ch);
+            if(isBack)
+                ExtractFeatures(back, GetChannelTimes(false, ch).data(), samplings, fFeatureSettings, fFeatures_B, ch);
+            else
+                fFeatures_B.ClearEstimators(ch);
+        }
+    }
+}
+
+
+
+void BarLYSO::SaveEvent()
+{   
+    if(fOverlay)
+    {
+        TraceScope scope("overlay", fEvent);
+        MixOverlay();
+    }
+
+    {
+        TraceScope scope("noise", fEvent);
+        (this->*fDigitizeKernel)();
+    }
+
+    TraceScope scope("fill", fEvent);
+
+    // The file takes the events the consumer of the ring can't keep up with
+    Bool_t isPublished = fShm && fShm->Publish(fEvent, fFront, fBack, fOutput.fShmTimeout);
+    if(fRNTuple)
+        fRNTuple->Fill(fEvent, fFront, fBack);
+    else if(fFlat)
+        fFlat->Write(fEvent, fFront, fBack);
+    else if(!isPublished && fOutTree)
+    {
+        fOutTree->Fill();
+        if(fShm) fShmFallbacks++;
+    }
+    if(fFeaturesTree)
+        fFeaturesTree->Fill();
+    if(fPhotonsTree)
+    {
+        fPhotonColumns_F.Pack(fPhotons_F, fNPulsePars);
+        fPhotonColumns_B.Pack(fPhotons_B, fNPulsePars);
+        fPhotonsTree->Fill();
+    }
 }
 
 
 
 void BarLYSO::SaveBar()
 {
+    if(!fOutFile)
+        return;
+
     fOutFile->cd();
-    fOutTree->Write("lyso_wfs");
-    fTimesTree->Write("lyso_wfs_times");
+    if(fOutTree)
+    {
+        WriteProgress(fLastEntry);
+        fOutTree->Write("lyso_wfs", TObject::kOverwrite);
+        fTimesTree->Write("lyso_wfs_times", TObject::kOverwrite);
+    }
+    if(fRNTuple)
+        fRNTuple->Close();
+    if(fFlat)
+        fFlat->Close();
+    if(fFeaturesTree)
+        fFeaturesTree->Write("lyso_features", TObject::kOverwrite);
+    if(fPhotonsTree)
+        fPhotonsTree->Write("lyso_photons", TObject::kOverwrite);
+
+    // Let the consumer drain the ring
+    if(fShm)
+        fShm->Close(10 * fOutput.fShmTimeout);
 }
\ No newline at end of file
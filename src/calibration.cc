@@ -0,0 +1,54 @@
+/**
+ * @file calibration.cc
+ * @brief Definition of the function @ref LoadCalibrationTable()
+ */
+#include "calibration.hh"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+
+Int_t LoadCalibrationTable(const string &filename, Int_t channels, Float_t gainTemplate, const ChannelCalibration &defaults, vector<ChannelCalibration> &front, vector<ChannelCalibration> &back)
+{
+    ifstream file(filename);
+    if(!file)
+    {
+        cerr << "Can't open the calibration table " << filename << endl;
+        return -1;
+    }
+
+    front.assign(channels, defaults);
+    back.assign(channels, defaults);
+
+    Int_t nRead = 0;
+    string line;
+    while(getline(file, line))
+    {
+        size_t first = line.find_first_not_of(" \t");
+        if(first == string::npos || line[first] == '#')
+            continue;
+
+        istringstream iss(line);
+        string side, flag;
+        Int_t channel;
+        Float_t gain, baseline, sigma;
+        if(!(iss >> side >> channel >> gain >> baseline >> sigma >> flag) || (side != "F" && side != "B")
+           || channel < 0 || channel >= channels || (flag != "ok" && flag != "dead" && flag != "hot"))
+        {
+            cerr << "Invalid line of the calibration table " << filename << ": " << line << endl;
+            return -1;
+        }
+
+        ChannelCalibration &calibration = (side == "F") ? front[channel] : back[channel];
+        calibration.fFactor = (flag == "dead") ? 0.f : (Float_t) pow(10., (gain - gainTemplate) / 20.);
+        calibration.fBaseline = baseline;
+        calibration.fSigmaNoise = (flag == "hot") ? HOT_NOISE_FACTOR * sigma : sigma;
+        nRead++;
+    }
+
+    return nRead;
+}
@@ -69,6 +69,22 @@ void Bartender_Configure(const char* filename, BarLYSO* bar, SiPM* sipm)
         {
             sipm->fT = stof(extract_value(line, "T ="));
         }
+        else if(line.find("Dark count rate =") != string::npos)
+        {
+            sipm->fNoise.fDarkRate = stod(extract_value(line, "Dark count rate ="));
+        }
+        else if(line.find("Crosstalk probability =") != string::npos)
+        {
+            sipm->fNoise.fCrosstalk = stod(extract_value(line, "Crosstalk probability ="));
+        }
+        else if(line.find("Afterpulse probability =") != string::npos)
+        {
+            sipm->fNoise.fAfterpulse = stod(extract_value(line, "Afterpulse probability ="));
+        }
+        else if(line.find("Afterpulse tau =") != string::npos)
+        {
+            sipm->fNoise.fAfterpulseTau = stod(extract_value(line, "Afterpulse tau ="));
+        }
         else if(line.find("Sampling speed =") != string::npos)
         {
             bar->GetDAQ()->fSamplingSpeed_Template = stof(extract_value(line, "Sampling speed ="));
@@ -93,6 +109,20 @@ void Bartender_Configure(const char* filename, BarLYSO* bar, SiPM* sipm)
         {
             bar->GetDAQ()->fSigmaBinSize = stof(extract_value(line, "BinSize sigma ="));
         }
+        else if(line.find("Jitter pool =") != string::npos)
+        {
+            bar->GetDAQ()->fJitterPool = stoi(extract_value(line, "Jitter pool ="));
+        }
+        else if(line.find("Synthesis rate =") != string::npos)
+        {
+            string rate = extract_value(line, "Synthesis rate =");
+            if(rate == "off")
+                bar->GetDAQ()->fSamplingSpeed_Synthesis = 0;
+            else if(rate == "template")
+                bar->GetDAQ()->fSamplingSpeed_Synthesis = -1;
+            else
+                bar->GetDAQ()->fSamplingSpeed_Synthesis = stof(rate);
+        }
         else if(line.find("Use shaping =") != string::npos)
         {
             bar->GetDAQ()->fIsShaping = (extract_value(line, "Use shaping =") == "true");
@@ -109,6 +139,159 @@ void Bartender_Configure(const char* filename, BarLYSO* bar, SiPM* sipm)
         {
             bar->GetDAQ()->fSigmaNoise = stof(extract_value(line, "Noise (sigma) ="));
         }
+        else if(line.find("Calibration table =") != string::npos)
+        {
+            string table = extract_value(line, "Calibration table =");
+            bar->SetCalibrationTable((table == "none") ? "" : table);
+        }
+        else if(line.find("ADC range =") != string::npos)
+        {
+            string range = extract_value(line, "ADC range =");
+            Float_t *adcRange = bar->GetDAQ()->fADCRange;
+            istringstream iss(range);
+            if(range == "none")
+            {
+                adcRange[0] = -FLT_MAX;
+                adcRange[1] = FLT_MAX;
+            }
+            else if(!(iss >> adcRange[0] >> adcRange[1]))
+                cerr << "Invalid ADC range: " << range << endl;
+        }
+        else if(line.find("Checkpoint every =") != string::npos)
+        {
+            bar->GetOutput()->fCheckpointEvents = stoll(extract_value(line, "Checkpoint every ="));
+        }
+        else if(line.find("Compression =") != string::npos)
+        {
+            string data = extract_value(line, "Compression =");
+            istringstream iss(data);
+            string algorithm;
+            Int_t level;
+            if(iss >> algorithm)
+            {
+                bar->GetOutput()->fCompressionAlgorithm = algorithm;
+                if(iss >> level)
+                    bar->GetOutput()->fCompressionLevel = level;
+            }
+        }
+        else if(line.find("Basket size:") != string::npos)
+        {
+            string data = extract_value(line, "Basket size:");
+            istringstream iss(data);
+            string branch;
+            Int_t size;
+            if(iss >> branch >> size)
+            {
+                bar->GetOutput()->fBasketSizes[branch] = size;
+            }
+        }
+        else if(line.find("AutoFlush =") != string::npos)
+        {
+            bar->GetOutput()->fAutoFlush = stoll(extract_value(line, "AutoFlush ="));
+        }
+        else if(line.find("AutoSave =") != string::npos)
+        {
+            bar->GetOutput()->fAutoSave = stoll(extract_value(line, "AutoSave ="));
+        }
+        else if(line.find("Memory cap =") != string::npos)
+        {
+            bar->GetOutput()->fMemoryCap = static_cast<Long64_t>(stod(extract_value(line, "Memory cap =")) * 1e6);
+        }
+        else if(line.find("Approx threshold =") != string::npos)
+        {
+            bar->SetApproxThreshold(stoi(extract_value(line, "Approx threshold =")));
+        }
+        else if(line.find("Channels =") != string::npos)
+        {
+            bar->SetGeometry(stoi(extract_value(line, "Channels =")), bar->GetSamplings());
+        }
+        else if(line.find("Samplings =") != string::npos)
+        {
+            bar->SetGeometry(bar->GetChannels(), stoi(extract_value(line, "Samplings =")));
+        }
+        else if(line.find("Output sink =") != string::npos)
+        {
+            bar->GetOutput()->fSink = extract_value(line, "Output sink =");
+        }
+        else if(line.find("Shm name =") != string::npos)
+        {
+            bar->GetOutput()->fShmName = extract_value(line, "Shm name =");
+        }
+        else if(line.find("Shm slots =") != string::npos)
+        {
+            bar->GetOutput()->fShmSlots = stoi(extract_value(line, "Shm slots ="));
+        }
+        else if(line.find("Shm timeout =") != string::npos)
+        {
+            bar->GetOutput()->fShmTimeout = stoi(extract_value(line, "Shm timeout ="));
+        }
+        else if(line.find("Binary chunk =") != string::npos)
+        {
+            bar->GetOutput()->fFlatChunkEvents = stoll(extract_value(line, "Binary chunk ="));
+        }
+        else if(line.find("Save features =") != string::npos)
+        {
+            bar->GetFeatureSettings()->fIsEnabled = (extract_value(line, "Save features =") == "true");
+        }
+        else if(line.find("Save photons =") != string::npos)
+        {
+            bar->GetOutput()->fIsSavingPhotons = (extract_value(line, "Save photons =") == "true");
+        }
+        else if(line.find("Baseline samples =") != string::npos)
+        {
+            bar->GetFeatureSettings()->fBaselineSamples = stoi(extract_value(line, "Baseline samples ="));
+        }
+        else if(line.find("CF fraction =") != string::npos)
+        {
+            bar->GetFeatureSettings()->fCFFraction = stof(extract_value(line, "CF fraction ="));
+        }
+        else if(line.find("Pulse model =") != string::npos)
+        {
+            bar->SetPulseModel(extract_value(line, "Pulse model ="));
+        }
+        else if(line.find("Free-running rate =") != string::npos)
+        {
+            bar->SetFreeRunningRate(stod(extract_value(line, "Free-running rate =")));
+        }
+        else if(line.find("Overlay library =") != string::npos)
+        {
+            string library = extract_value(line, "Overlay library =");
+            bar->SetOverlayLibrary((library == "none") ? "" : library);
+        }
+        else if(line.find("Overlay events =") != string::npos)
+        {
+            bar->SetOverlayEvents(stoi(extract_value(line, "Overlay events =")));
+        }
+        else if(line.find("Overlay window =") != string::npos)
+        {
+            bar->SetOverlayWindow(stod(extract_value(line, "Overlay window =")));
+        }
+        else if(line.find("Front channels:") != string::npos)
+        {
+            EventFilter filter = bar->GetFilter();
+            filter.fChannels_F = extract_value(line, "Front channels:");
+            bar->SetFilter(filter);
+        }
+        else if(line.find("Back channels:") != string::npos)
+        {
+            EventFilter filter = bar->GetFilter();
+            filter.fChannels_B = extract_value(line, "Back channels:");
+            bar->SetFilter(filter);
+        }
+        else if(line.find("Front hits:") != string::npos)
+        {
+            EventFilter filter = bar->GetFilter();
+            istringstream iss(extract_value(line, "Front hits:"));
+            if(iss >> filter.fHits_F[0] >> filter.fHits_F[1])
+                bar->SetFilter(filter);
+        }
+        else if(line.find("Back hits:") != string::npos)
+        {
+            EventFilter filter = bar->GetFilter();
+            istringstream iss(extract_value(line, "Back hits:"));
+            if(iss >> filter.fHits_B[0] >> filter.fHits_B[1])
+                bar->SetFilter(filter);
+        }
         else if(line.find("PathToFile:") != string::npos)
         {
             bar->SetInputFilename(extract_value(line, "PathToFile:"));
@@ -156,4 +339,73 @@ void Bartender_Configure(const char* filename, BarLYSO* bar, SiPM* sipm)
     }
     
     file.close();
-}
\ No newline at end of file
+
+    // The noise of the SiPM type is added by the generator
+    bar->SetSiPMNoise(sipm->fNoise);
+}
+
+
+
+void Bartender_Configure(const BarSettings& settings, BarLYSO* bar)
+{
+    DAQ *daq = bar->GetDAQ();
+    daq->fSamplingSpeed_Template = settings.fSamplingSpeed_Template;
+    daq->fR_shaper_Template = settings.fR_shaper_Template;
+    daq->fGain_Template = settings.fGain_Template;
+    daq->fIsBinSizeConstant = settings.fIsBinSizeConstant;
+    daq->fSamplingSpeed = settings.fSamplingSpeed;
+    daq->fSigmaBinSize = settings.fSigmaBinSize;
+    daq->fJitterPool = settings.fJitterPool;
+    daq->fSamplingSpeed_Synthesis = settings.fSamplingSpeed_Synthesis;
+    daq->fIsShaping = settings.fIsShaping;
+    daq->fTau_shaping = settings.fTau_shaping;
+    daq->fGain = settings.fGain;
+    daq->fSigmaNoise = settings.fSigmaNoise;
+    daq->fADCRange[0] = settings.fADCRange[0];
+    daq->fADCRange[1] = settings.fADCRange[1];
+    bar->SetCalibrationTable(settings.fCalibrationTable);
+    bar->SetSiPMNoise(settings.fSiPMNoise);
+    bar->SetApproxThreshold(settings.fApproxThreshold);
+    bar->SetGeometry(settings.fChannels, settings.fSamplings);
+
+    bar->SetPulseModel(settings.fPulseModel);
+    bar->SetFreeRunningRate(settings.fFreeRunningRate);
+    bar->SetOverlayLibrary(settings.fOverlayLibrary);
+    bar->SetOverlayEvents(settings.fOverlayEvents);
+    bar->SetOverlayWindow(settings.fOverlayWindow);
+    bar->SetInputFilename(settings.fParsFilename);
+    bar->SetChargeCuts(settings.fChargeCuts[0], settings.fChargeCuts[1]);
+    bar->SetHisto_A(settings.fHisto_A[0], settings.fHisto_A[1], settings.fHisto_A[2]);
+    bar->SetHisto_Tau_rise(settings.fHisto_Tau_rise[0], settings.fHisto_Tau_rise[1], settings.fHisto_Tau_rise[2]);
+    bar->SetHisto_Tau_dec(settings.fHisto_Tau_dec[0], settings.fHisto_Tau_dec[1], settings.fHisto_Tau_dec[2]);
+
+    *bar->GetOutput() = settings.fOutput;
+    bar->SetFilter(settings.fFilter);
+    *bar->GetFeatureSettings() = settings.fFeatures;
+}
+
+
+
+void Bartender_ApplyFilterOptions(const vector<pair<string, string>> &options, BarLYSO* bar)
+{
+    if(options.empty())
+        return;
+
+    EventFilter filter = bar->GetFilter();
+    for(const auto &entry : options)
+    {
+        const string &option = entry.first, &value = entry.second;
+        if(option == "--channels-F")
+            filter.fChannels_F = value;
+        else if(option == "--channels-B")
+            filter.fChannels_B = value;
+        else
+        {
+            Int_t *range = (option == "--hits-F") ? filter.fHits_F : filter.fHits_B;
+            istringstream iss(value);
+            if(!(iss >> range[0] >> range[1]))
+                cerr << "Invalid range of hits \"" << value << "\" after " << option << endl;
+        }
+    }
+    bar->SetFilter(filter);
+}
@@ -0,0 +1,228 @@
+/**
+ * @file eventloop.cc
+ * @brief Definition of the reader of the MC input and of the event loop
+ */
+#include "eventloop.hh"
+#include "trace.hh"
+
+using namespace std;
+
+
+namespace
+{
+    void PrintProgress(const string &prefix, Long64_t k, Long64_t nEntries)
+    {
+        if(!prefix.empty() && (nEntries < 10 || k % (nEntries / 10) == 0))
+            cout << "\r" << prefix << "Processed " << k + 1 << " events" << flush;
+    }
+}
+
+
+Bool_t McInput::Open(const char *filename)
+{
+    Close();
+
+    fFile.reset(TFile::Open(filename, "READ"));
+    if(!fFile || fFile->IsZombie())
+    {
+        cerr << "Can't open the MC file " << filename << endl;
+        fFile.reset();
+        return false;
+    }
+    fTree = fFile->Get<TTree>("lyso");
+    if(!fTree)
+    {
+        cerr << "No lyso tree in " << filename << endl;
+        fFile.reset();
+        return false;
+    }
+
+    fTree->SetBranchStatus("*", false);
+    fTree->SetBranchStatus("Event", true);
+    fTree->SetBranchStatus("NHits_F", true);
+    fTree->SetBranchStatus("NHits_B", true);
+    fTree->SetBranchStatus("T_F", true);
+    fTree->SetBranchStatus("Ch_F", true);
+    fTree->SetBranchStatus("T_B", true);
+    fTree->SetBranchStatus("Ch_B", true);
+
+    fTree->SetBranchAddress("Event", &fEvent);
+    fTree->SetBranchAddress("NHits_F", &fNHits_F);
+    fTree->SetBranchAddress("NHits_B", &fNHits_B);
+    fTree->SetBranchAddress("Ch_F", &fCh_F);
+    fTree->SetBranchAddress("Ch_B", &fCh_B);
+    fTree->SetBranchAddress("T_F", &fT_F);
+    fTree->SetBranchAddress("T_B", &fT_B);
+    fBranchNHits_F = fTree->GetBranch("NHits_F");
+    fBranchNHits_B = fTree->GetBranch("NHits_B");
+
+    return true;
+}
+
+
+
+void McInput::Close()
+{
+    if(fTree)
+        fTree->ResetBranchAddresses();
+    fTree = nullptr;
+    fBranchNHits_F = fBranchNHits_B = nullptr;
+    fFile.reset();
+
+    delete fT_F;
+    delete fT_B;
+    delete fCh_F;
+    delete fCh_B;
+    fT_F = fT_B = nullptr;
+    fCh_F = fCh_B = nullptr;
+}
+
+
+
+void Bartender_Loop(BarLYSO *bar, McInput &mc, Long64_t first, Long64_t last, const vector<SweepTarget> &sweeps, OverlayWriter *overlay, const string &prefix)
+{
+    const Long64_t nEntries = last;
+    const EventFilter &filter = bar->GetFilter();
+
+    for(Long64_t k = first; k < last; k++)
+    {
+        // Select on the numbers of hits before reading the photons
+        if(filter.IsSelectingEvents())
+        {
+            {
+                TraceScope scope("read hits", k);
+                mc.GetHits(k);
+            }
+            if(!filter.IsSelected(mc.fNHits_F, mc.fNHits_B))
+            {
+                // Only the progress records move on
+                for(const SweepTarget &sweep : sweeps)
+                {
+                    if(k >= sweep.fBar->GetResumeEntry())
+                        sweep.fBar->Checkpoint(k);
+                }
+                if(!bar->IsFreeRunning() && !overlay && k >= bar->GetResumeEntry())
+                    bar->Checkpoint(k);
+                PrintProgress(prefix, k, nEntries);
+                continue;
+            }
+        }
+
+        {
+            TraceScope scope("read", k);
+            mc.GetEntry(k);
+        }
+
+        // Entries before the resume entry of the main generator are only
+        // synthesized by the sweep configurations behind it, each with its own
+        // generators: those of the main one stay as restored from its checkpoint
+        if(!bar->IsFreeRunning() && !overlay && k < bar->GetResumeEntry())
+        {
+            for(const SweepTarget &sweep : sweeps)
+            {
+                if(k < sweep.fBar->GetResumeEntry())
+                    continue;
+                {
+                    TraceScope scope("sweep", mc.fEvent, mc.fNHits_F + mc.fNHits_B);
+                    sweep.fBar->InitializeBaselines(mc.fEvent);
+                    sweep.fBar->SetFrontWaveforms(mc.fNHits_F, mc.fCh_F->data(), mc.fT_F->data());
+                    sweep.fBar->SetBackWaveforms(mc.fNHits_B, mc.fCh_B->data(), mc.fT_B->data());
+                }
+                sweep.fBar->SaveEvent();
+                sweep.fBar->ClearContainers();
+                sweep.fBar->Checkpoint(k);
+            }
+            PrintProgress(prefix, k, nEntries);
+            continue;
+        }
+
+        if(bar->IsFreeRunning())
+        {
+            TraceScope scope("synthesis", mc.fEvent, mc.fNHits_F + mc.fNHits_B);
+            bar->AddFreeRunningEvent(mc.fEvent, mc.fNHits_F, mc.fCh_F->data(), mc.fT_F->data(), mc.fNHits_B, mc.fCh_B->data(), mc.fT_B->data());
+        }
+        else
+        {
+            TraceScope scope("synthesis", mc.fEvent, mc.fNHits_F + mc.fNHits_B);
+            bar->InitializeBaselines(mc.fEvent);
+            bar->SetFrontWaveforms(mc.fNHits_F, mc.fCh_F->data(), mc.fT_F->data());
+            bar->SetBackWaveforms(mc.fNHits_B, mc.fCh_B->data(), mc.fT_B->data());
+        }
+
+        // Fan out the event to the sweep configurations still to process it
+        for(const SweepTarget &sweep : sweeps)
+        {
+            if(k < sweep.fBar->GetResumeEntry())
+                continue;
+            {
+                TraceScope scope("sweep", mc.fEvent, mc.fNHits_F + mc.fNHits_B);
+                sweep.fBar->InitializeBaselines(mc.fEvent);
+                if(sweep.fIsSharingWaveforms)
+                    sweep.fBar->CopyWaveforms(*bar);
+                else
+                    sweep.fBar->SynthesizeFrom(*bar);
+            }
+            sweep.fBar->SaveEvent();
+            sweep.fBar->ClearContainers();
+            sweep.fBar->Checkpoint(k);
+        }
+
+        // In free-running mode the windows are saved when complete
+        if(!bar->IsFreeRunning())
+        {
+            if(overlay)
+                overlay->Write(bar->GetFront(), bar->GetBack(), bar->GetActive_F(), bar->GetActive_B());
+            else if(k >= bar->GetResumeEntry())
+            {
+                bar->SaveEvent();
+                bar->Checkpoint(k);
+            }
+            bar->ClearContainers();
+        }
+
+        PrintProgress(prefix, k, nEntries);
+    }
+    if(!prefix.empty())
+        cout << endl;
+
+    if(bar->IsFreeRunning())
+        bar->FlushFreeRunning();
+}
+
+
+
+void Bartender_Replay(BarLYSO *bar, PhotonCache &cache, Long64_t first, Long64_t last, const string &prefix)
+{
+    const Long64_t nEntries = last;
+    const EventFilter &filter = bar->GetFilter();
+    vector<Photon> photons_F, photons_B;
+
+    for(Long64_t k = first; k < last; k++)
+    {
+        {
+            TraceScope scope("read", k);
+            cache.GetEntry(k, photons_F, photons_B);
+        }
+
+        if(!filter.IsSelected(photons_F.size(), photons_B.size()))
+        {
+            bar->Checkpoint(k);
+            PrintProgress(prefix, k, nEntries);
+            continue;
+        }
+
+        {
+            TraceScope scope("synthesis", cache.fEvent, photons_F.size() + photons_B.size());
+            bar->InitializeBaselines(cache.fEvent);
+            bar->SynthesizePhotons(photons_F, photons_B, cache.GetPulseModel());
+        }
+
+        bar->SaveEvent();
+        bar->Checkpoint(k);
+        bar->ClearContainers();
+
+        PrintProgress(prefix, k, nEntries);
+    }
+    if(!prefix.empty())
+        cout << endl;
+}
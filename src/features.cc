@@ -0,0 +1,47 @@
+/**
+ * @file features.cc
+ * @brief Definition of the function @ref ExtractFeatures()
+ */
+#include "features.hh"
+
+#include <algorithm>
+
+
+void ExtractFeatures(const Float_t *wave, const Float_t *times, Int_t n, const FeatureSettings &settings, SideFeatures &features, Int_t channel)
+{
+    // Baseline
+    Int_t nBaseline = std::min(std::max(settings.fBaselineSamples, 1), n);
+    Double_t sum = 0;
+    for(Int_t i = 0; i < nBaseline; i++)
+        sum += wave[i];
+    Float_t baseline = sum / nBaseline;
+
+    // Minimum and charge in a single pass
+    Int_t iMin = 0;
+    Double_t charge = 0;
+    for(Int_t i = 0; i < n; i++)
+    {
+        if(wave[i] < wave[iMin]) iMin = i;
+        if(i < n - 1) charge += (baseline - wave[i]) * (times[i+1] - times[i]);
+    }
+    Float_t amplitude = baseline - wave[iMin];
+
+    // Constant fraction: walk back from the peak to the threshold crossing
+    Float_t threshold = baseline - settings.fCFFraction * amplitude;
+    Float_t cfTime = times[iMin];
+    for(Int_t i = iMin; i > 0; i--)
+    {
+        if(wave[i-1] >= threshold)
+        {
+            Float_t slope = (wave[i] - wave[i-1]) / (times[i] - times[i-1]);
+            cfTime = (slope != 0) ? times[i-1] + (threshold - wave[i-1]) / slope : times[i];
+            break;
+        }
+    }
+
+    features.fBaseline[channel] = baseline;
+    features.fAmplitude[channel] = amplitude;
+    features.fCharge[channel] = charge;
+    features.fPeakTime[channel] = times[iMin];
+    features.fCFTime[channel] = cfTime;
+}
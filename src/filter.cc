@@ -0,0 +1,50 @@
+/**
+ * @file filter.cc
+ * @brief Definition of the function @ref ParseChannelList()
+ */
+#include "filter.hh"
+
+#include <sstream>
+
+using namespace std;
+
+
+Bool_t ParseChannelList(const string &list, Int_t channels, vector<Char_t> &mask)
+{
+    if(list.empty() || list == "all")
+    {
+        mask.assign(channels, true);
+        return true;
+    }
+
+    mask.assign(channels, false);
+    string tokens = list;
+    for(char &c : tokens)
+    {
+        if(c == ',') c = ' ';
+    }
+
+    istringstream iss(tokens);
+    string token;
+    while(iss >> token)
+    {
+        Int_t first, last;
+        size_t dash = token.find('-');
+        try
+        {
+            first = stoi(token.substr(0, dash));
+            last = (dash == string::npos) ? first : stoi(token.substr(dash + 1));
+        }
+        catch(const exception&)
+        {
+            return false;
+        }
+        if(first < 0 || last >= channels || first > last)
+            return false;
+
+        for(Int_t ch = first; ch <= last; ch++)
+            mask[ch] = true;
+    }
+
+    return true;
+}
@@ -0,0 +1,186 @@
+/**
+ * @file flatexport.cc
+ * @brief Definition of the methods of the class FlatExporter
+ */
+#include "flatexport.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+
+namespace
+{
+    constexpr size_t FLAT_BUFFER_SIZE = 1 << 22; // Bytes buffered by the chunk stream
+
+    // File name without the directories, as referenced by the sidecar
+    string BaseName(const string &path)
+    {
+        return path.substr(path.find_last_of('/') + 1);
+    }
+}
+
+
+
+bool FlatExporter::Open(const string &base, uint32_t channels, uint32_t samplings, int32_t mcid, uint64_t chunkEvents, float samplingSpeed, bool isBinSizeConstant)
+{
+    fBase = base;
+    fChannels = channels;
+    fSamplings = samplings;
+    fMCID = mcid;
+    fChunkEvents = chunkEvents;
+    fSamplingSpeed = samplingSpeed;
+    fIsBinSizeConstant = isBinSizeConstant;
+    fBuffer.resize(FLAT_BUFFER_SIZE);
+
+    fIsOpen = OpenChunk();
+    return fIsOpen;
+}
+
+
+
+bool FlatExporter::OpenChunk()
+{
+    if(fChunk.is_open())
+        fChunk.close();
+
+    string filename = fBase + ".bin";
+    if(fChunkEvents > 0)
+    {
+        char index[16];
+        snprintf(index, sizeof(index), "_%04zu", fChunkFiles.size());
+        filename = fBase + index + ".bin";
+    }
+
+    fChunk.rdbuf()->pubsetbuf(fBuffer.data(), fBuffer.size());
+    fChunk.open(filename, ios::binary | ios::trunc);
+    if(!fChunk)
+    {
+        cerr << "Can't create " << filename << endl;
+        return false;
+    }
+
+    fChunkFiles.push_back(filename);
+    fChunkSizes.push_back(0);
+    return true;
+}
+
+
+
+void FlatExporter::WriteFloats(ofstream &file, const float *values, size_t n)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    vector<uint32_t> swapped(n);
+    memcpy(swapped.data(), values, n * sizeof(float));
+    for(uint32_t &v : swapped)
+        v = __builtin_bswap32(v);
+    file.write(reinterpret_cast<const char*>(swapped.data()), n * sizeof(float));
+#else
+    file.write(reinterpret_cast<const char*>(values), n * sizeof(float));
+#endif
+}
+
+
+
+void FlatExporter::SetTimes(const vector<vector<float>> &times_F, const vector<vector<float>> &times_B)
+{
+    if(!fIsOpen)
+        return;
+
+    ofstream file(fBase + "_times.bin", ios::binary | ios::trunc);
+    for(const auto *side : {&times_F, &times_B})
+    {
+        for(uint32_t ch = 0; ch < fChannels; ch++)
+            WriteFloats(file, (*side)[ch].data(), fSamplings);
+    }
+}
+
+
+
+bool FlatExporter::Write(int32_t event, const vector<vector<float>> &front, const vector<vector<float>> &back)
+{
+    if(!fIsOpen)
+        return false;
+
+    if(fChunkEvents > 0 && fChunkSizes.back() == fChunkEvents && !OpenChunk())
+    {
+        fIsOpen = false;
+        return false;
+    }
+
+    // Masked channels are empty: written as zeros to keep the layout
+    vector<float> zeros;
+    for(const auto *side : {&front, &back})
+    {
+        for(uint32_t ch = 0; ch < fChannels; ch++)
+        {
+            if((*side)[ch].empty() && zeros.empty())
+                zeros.assign(fSamplings, 0);
+            WriteFloats(fChunk, (*side)[ch].empty() ? zeros.data() : (*side)[ch].data(), fSamplings);
+        }
+    }
+    if(!fChunk)
+    {
+        cerr << "Write error on " << fChunkFiles.back() << endl;
+        fIsOpen = false;
+        return false;
+    }
+
+    fEvents.push_back(event);
+    fChunkSizes.back()++;
+    fBytes += 2 * (uint64_t) fChannels * fSamplings * sizeof(float);
+    return true;
+}
+
+
+
+void FlatExporter::Close()
+{
+    if(fChunkFiles.empty() || fIsClosed)
+        return;
+    if(fChunk.is_open())
+        fChunk.close();
+
+    // Event numbers, int32
+    ofstream events(fBase + "_events.bin", ios::binary | ios::trunc);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for(int32_t &event : fEvents)
+        event = (int32_t) __builtin_bswap32((uint32_t) event);
+#endif
+    events.write(reinterpret_cast<const char*>(fEvents.data()), fEvents.size() * sizeof(int32_t));
+    events.close();
+
+    // JSON sidecar, with the files relative to its directory
+    ofstream json(fBase + ".json", ios::trunc);
+    json << "{\n";
+    json << "  \"format\": \"bartender-flat\",\n";
+    json << "  \"version\": 1,\n";
+    json << "  \"mcid\": " << fMCID << ",\n";
+    json << "  \"dtype\": \"<f4\",\n";
+    json << "  \"order\": \"C\",\n";
+    json << "  \"axes\": [\"event\", \"side\", \"channel\", \"sampling\"],\n";
+    json << "  \"sides\": [\"front\", \"back\"],\n";
+    json << "  \"events\": " << fEvents.size() << ",\n";
+    json << "  \"channels\": " << fChannels << ",\n";
+    json << "  \"samplings\": " << fSamplings << ",\n";
+    json << "  \"sampling_speed_gsps\": " << fSamplingSpeed << ",\n";
+    json << "  \"constant_bins\": " << (fIsBinSizeConstant ? "true" : "false") << ",\n";
+    json << "  \"times\": {\"file\": \"" << BaseName(fBase) << "_times.bin\", \"dtype\": \"<f4\", \"shape\": [2, " << fChannels << ", " << fSamplings << "]},\n";
+    json << "  \"event_numbers\": {\"file\": \"" << BaseName(fBase) << "_events.bin\", \"dtype\": \"<i4\", \"shape\": [" << fEvents.size() << "]},\n";
+    json << "  \"chunks\": [\n";
+    uint64_t first = 0;
+    for(size_t c = 0; c < fChunkFiles.size(); c++)
+    {
+        json << "    {\"file\": \"" << BaseName(fChunkFiles[c]) << "\", \"first\": " << first << ", \"events\": " << fChunkSizes[c] << "}"
+             << ((c + 1 < fChunkFiles.size()) ? ",\n" : "\n");
+        first += fChunkSizes[c];
+    }
+    json << "  ]\n";
+    json << "}\n";
+
+    fIsOpen = false;
+    fIsClosed = true;
+}
@@ -0,0 +1,224 @@
+/**
+ * @file freerun.cc
+ * @brief Definition of the methods of the class BarLYSO for the free-running
+ * digitizer mode with pile-up
+ */
+#include "bar.hh"
+
+#include <algorithm>
+
+using namespace std;
+using namespace TMath;
+
+
+namespace
+{
+    constexpr Double_t FREE_PULSE_LENGTH = 20; // Time constants after which a 1-Phel waveform is neglected
+}
+
+
+
+void BarLYSO::BeginFreeRunning()
+{
+    if(fSiPMNoise.IsEnabled())
+        cerr << "The free-running mode doesn't simulate the noise of the SiPMs, the dark counts, crosstalk and afterpulses are ignored" << endl;
+
+    // The windows are slices of a single sampling grid
+    if(!fDAQ->fIsBinSizeConstant)
+    {
+        cerr << "The free-running mode needs constant bins, the bin size spread is ignored" << endl;
+        fDAQ->fIsBinSizeConstant = true;
+    }
+
+    Long64_t capacity = 1;
+    while(capacity < 4 * (Long64_t) fSamplings)
+        capacity <<= 1;
+    fRingMask = capacity - 1;
+    fRing_F.assign(fChannels, vector<Float_t>(capacity, 0));
+    fRing_B.assign(fChannels, vector<Float_t>(capacity, 0));
+
+    // The first window starts at the beginning of the timeline
+    fFreeTime = ZERO_TIME_BIN;
+    fRingStart = 0;
+    fFreePileUps = 0;
+    fTriggers.clear();
+}
+
+
+
+template<class Pulse>
+void BarLYSO::AddRingPulseKernel(vector<Float_t> &ring, Long64_t first, Int_t nSamples, Double_t firstTime, const Double_t *pars)
+{
+    const Double_t dt = 1. / fDAQ->fSamplingSpeed;
+    Float_t *r = ring.data();
+
+    // The pulse is evaluated in the time from its start, which stays small
+    // on long timelines; it wraps around the end of the ring
+    for(Int_t i = 0; i < nSamples; i++)
+    {
+        r[(first + i) & fRingMask] += Pulse::Eval(static_cast<Float_t>(firstTime + i * dt), pars, 0);
+    }
+}
+
+template void BarLYSO::AddRingPulseKernel<TwoExpPulse>(vector<Float_t>&, Long64_t, Int_t, Double_t, const Double_t*);
+template void BarLYSO::AddRingPulseKernel<ThreeExpPulse>(vector<Float_t>&, Long64_t, Int_t, Double_t, const Double_t*);
+template void BarLYSO::AddRingPulseKernel<FastSlowPulse>(vector<Float_t>&, Long64_t, Int_t, Double_t, const Double_t*);
+
+
+
+void BarLYSO::GrowRing(Long64_t samples)
+{
+    Long64_t oldCapacity = fRingMask + 1;
+    Long64_t capacity = oldCapacity;
+    while(capacity < samples)
+        capacity <<= 1;
+    if(capacity == oldCapacity)
+        return;
+
+    // Move the live samples to their slots in the larger rings
+    for(auto *rings : {&fRing_F, &fRing_B})
+    {
+        for(auto &ring : *rings)
+        {
+            vector<Float_t> larger(capacity, 0);
+            for(Long64_t n = fRingStart; n < fRingStart + oldCapacity; n++)
+                larger[n & (capacity - 1)] = ring[n & fRingMask];
+            ring.swap(larger);
+        }
+    }
+    fRingMask = capacity - 1;
+}
+
+
+
+void BarLYSO::DepositFreeRunning(Bool_t isFront, Double_t arrival, Int_t nHits, const Int_t *channels, const Double_t *starts)
+{
+    const Double_t dt = 1. / fDAQ->fSamplingSpeed;
+    auto &rings = isFront ? fRing_F : fRing_B;
+    const vector<Char_t> &mask = isFront ? fMask_F : fMask_B;
+
+    for(Int_t j = 0; j < nHits; j++)
+    {
+        if(!IsValidChannel(channels[j]) || !mask[channels[j]])
+            continue;
+
+        Double_t pars[MAX_PULSE_PARS];
+        SamplePulsePars(pars);
+
+        // Samples strictly after the photon, up to the end of the pulse; the
+        // part before the oldest window still needed is lost anyway
+        Double_t time = arrival + starts[j];
+        Long64_t first = Max((Long64_t) floor(time / dt) + 1, fRingStart);
+        Int_t nSamples = (Int_t) ceil(FREE_PULSE_LENGTH * fPulseDuration(pars) / dt);
+        if(first + nSamples - fRingStart > fRingMask + 1)
+            GrowRing(first + nSamples - fRingStart);
+
+        (this->*fAddRingPulseKernel)(rings[channels[j]], first, nSamples, first * dt - time, pars);
+    }
+}
+
+
+
+void BarLYSO::SaveFreeRunningWindow(const FreeTrigger &trigger)
+{
+    InitializeBaselines(trigger.fEvent);
+
+    for(Int_t ch = 0; ch < fChannels; ch++)
+    {
+        const Float_t *ring_F = fRing_F[ch].data();
+        const Float_t *ring_B = fRing_B[ch].data();
+        Float_t *front = fFront[ch].data();
+        Float_t *back = fBack[ch].data();
+
+        // Masked channels are empty; the ring may hold the tails of earlier
+        // events in any channel
+        for(Int_t bin = 0; bin < (Int_t) fFront[ch].size(); bin++)
+            front[bin] = ring_F[(trigger.fStart + bin) & fRingMask];
+        for(Int_t bin = 0; bin < (Int_t) fBack[ch].size(); bin++)
+            back[bin] = ring_B[(trigger.fStart + bin) & fRingMask];
+        fActive_F[ch] = fActive_B[ch] = true;
+    }
+
+    // The truth is that of the triggering event only
+    if(fFeatureSettings.fIsEnabled)
+    {
+        for(size_t j = 0; j < trigger.fCh_F.size(); j++) fFeatures_F.AddPhoton(trigger.fCh_F[j], trigger.fT_F[j]);
+        for(size_t j = 0; j < trigger.fCh_B.size(); j++) fFeatures_B.AddPhoton(trigger.fCh_B[j], trigger.fT_B[j]);
+    }
+
+    SaveEvent();
+    ClearContainers();
+}
+
+
+
+void BarLYSO::ReleaseFreeRunning(Long64_t untilSample)
+{
+    while(!fTriggers.empty() && fTriggers.front().fStart + fSamplings <= untilSample)
+    {
+        SaveFreeRunningWindow(fTriggers.front());
+        fTriggers.pop_front();
+    }
+
+    // Zero the slots of the samples no window needs, to be reused: after a
+    // long gap between events that is the whole ring, which then starts again
+    // at the oldest sample still needed
+    Long64_t newStart = fTriggers.empty() ? untilSample : Min(untilSample, fTriggers.front().fStart);
+    Long64_t zeroEnd = Min(newStart, fRingStart + fRingMask + 1);
+    for(auto *rings : {&fRing_F, &fRing_B})
+    {
+        for(auto &ring : *rings)
+        {
+            for(Long64_t n = fRingStart; n < zeroEnd; n++)
+                ring[n & fRingMask] = 0;
+        }
+    }
+    fRingStart = Max(fRingStart, newStart);
+}
+
+
+
+void BarLYSO::AddFreeRunningEvent(Int_t event, Int_t nHits_F, const Int_t *channels_F, const Double_t *starts_F, Int_t nHits_B, const Int_t *channels_B, const Double_t *starts_B)
+{
+    const Double_t dt = 1. / fDAQ->fSamplingSpeed;
+
+    // Poisson arrivals: exponential spacing with mean 1/rate
+    Double_t spacing = fRandPars->Exp(1.e3 / fFreeRate);
+    if(fFreeTime > ZERO_TIME_BIN && spacing < fSamplings * dt)
+        fFreePileUps++;
+    fFreeTime += spacing;
+
+    // The photons of this and later events come after its arrival, so the
+    // windows ending before it are complete
+    Long64_t windowStart = (Long64_t) floor((fFreeTime - ZERO_TIME_BIN) / dt);
+    ReleaseFreeRunning(windowStart);
+
+    DepositFreeRunning(true, fFreeTime, nHits_F, channels_F, starts_F);
+    DepositFreeRunning(false, fFreeTime, nHits_B, channels_B, starts_B);
+
+    FreeTrigger trigger;
+    trigger.fEvent = event;
+    trigger.fStart = windowStart;
+    if(fFeatureSettings.fIsEnabled)
+    {
+        trigger.fCh_F.assign(channels_F, channels_F + nHits_F);
+        trigger.fT_F.assign(starts_F, starts_F + nHits_F);
+        trigger.fCh_B.assign(channels_B, channels_B + nHits_B);
+        trigger.fT_B.assign(starts_B, starts_B + nHits_B);
+    }
+    fTriggers.push_back(move(trigger));
+}
+
+
+
+void BarLYSO::FlushFreeRunning()
+{
+    if(fTriggers.empty())
+        return;
+
+    ReleaseFreeRunning(fTriggers.back().fStart + fSamplings);
+
+    string prefix = (fThreadID == -1) ? "BarST>> " : "BarWT" + to_string(fThreadID) + ">> ";
+    cout << prefix << "Free-running timeline of " << (fFreeTime - ZERO_TIME_BIN) / 1.e3 << " us, " << fFreePileUps
+         << " events within a window length of the previous one" << endl;
+}
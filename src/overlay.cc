@@ -0,0 +1,197 @@
+/**
+ * @file overlay.cc
+ * @brief Definition of the methods of the classes OverlayWriter and
+ * OverlayLibrary
+ */
+#include "overlay.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+namespace
+{
+    constexpr char OVERLAY_MAGIC[8] = {'B', 'A', 'R', 'O', 'V', 'L', '0', '1'};
+    constexpr uint32_t OVERLAY_ENDIANNESS = 0x01020304;
+
+    // Bytes of an event: scales, then samples
+    size_t EventSize(uint32_t channels, uint32_t samplings)
+    {
+        return 2 * channels * (sizeof(float) + samplings * sizeof(int16_t));
+    }
+}
+
+
+
+bool OverlayWriter::Open(const string &filename, uint32_t channels, uint32_t samplings, float samplingSpeed)
+{
+    memcpy(fHeader.fMagic, OVERLAY_MAGIC, sizeof(OVERLAY_MAGIC));
+    fHeader.fEndianness = OVERLAY_ENDIANNESS;
+    fHeader.fChannels = channels;
+    fHeader.fSamplings = samplings;
+    fHeader.fSamplingSpeed = samplingSpeed;
+    fHeader.fEvents = 0;
+
+    fFile.open(filename, ios::binary | ios::trunc);
+    if(!fFile)
+    {
+        cerr << "Can't create the overlay library " << filename << endl;
+        return false;
+    }
+    fFile.write(reinterpret_cast<const char*>(&fHeader), sizeof(fHeader));
+
+    fScales.resize(2 * channels);
+    fSamples.resize(2 * channels * samplings);
+    return true;
+}
+
+
+
+bool OverlayWriter::Write(const vector<vector<float>> &front, const vector<vector<float>> &back, const vector<char> &active_F, const vector<char> &active_B)
+{
+    if(!fFile.is_open())
+        return false;
+
+    const uint32_t channels = fHeader.fChannels;
+    const uint32_t samplings = fHeader.fSamplings;
+    for(uint32_t w = 0; w < 2 * channels; w++)
+    {
+        const vector<float> &source = (w < channels) ? front[w] : back[w - channels];
+        const bool isActive = (w < channels) ? active_F[w] : active_B[w - channels];
+        int16_t *samples = fSamples.data() + w * samplings;
+
+        // Masked channels are empty and the others without a signal hold the
+        // samples of an earlier event: stored as zeros
+        if(source.empty() || !isActive)
+        {
+            fill_n(samples, samplings, 0);
+            fScales[w] = 0;
+            continue;
+        }
+        const float *wave = source.data();
+
+        // Full scale of int16 on the largest sample of the waveform
+        float peak = 0;
+        for(uint32_t bin = 0; bin < samplings; bin++)
+            peak = max(peak, fabs(wave[bin]));
+        float scale = peak / 32767.f;
+        float inverse = (peak > 0) ? 1.f / scale : 0.f;
+        for(uint32_t bin = 0; bin < samplings; bin++)
+            samples[bin] = static_cast<int16_t>(lrintf(wave[bin] * inverse));
+        fScales[w] = scale;
+    }
+
+    fFile.write(reinterpret_cast<const char*>(fScales.data()), fScales.size() * sizeof(float));
+    fFile.write(reinterpret_cast<const char*>(fSamples.data()), fSamples.size() * sizeof(int16_t));
+    if(!fFile)
+        return false;
+
+    fHeader.fEvents++;
+    return true;
+}
+
+
+
+void OverlayWriter::Close()
+{
+    if(!fFile.is_open())
+        return;
+
+    fFile.seekp(0);
+    fFile.write(reinterpret_cast<const char*>(&fHeader), sizeof(fHeader));
+    fFile.close();
+}
+
+
+
+bool OverlayLibrary::Open(const string &filename)
+{
+    Close();
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        cerr << "Can't open the overlay library " << filename << endl;
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(OverlayHeader))
+    {
+        cerr << filename << " is not an overlay library" << endl;
+        close(fd);
+        return false;
+    }
+
+    void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED)
+    {
+        cerr << "Can't map the overlay library " << filename << endl;
+        return false;
+    }
+
+    OverlayHeader header;
+    memcpy(&header, base, sizeof(header));
+    size_t eventSize = EventSize(header.fChannels, header.fSamplings);
+    if(memcmp(header.fMagic, OVERLAY_MAGIC, sizeof(OVERLAY_MAGIC)) != 0 || header.fEndianness != OVERLAY_ENDIANNESS
+       || (size_t) st.st_size < sizeof(OverlayHeader) + header.fEvents * eventSize)
+    {
+        cerr << filename << " is not an overlay library of this host, or is truncated" << endl;
+        munmap(base, st.st_size);
+        return false;
+    }
+
+    // The events are picked at random
+    madvise(base, st.st_size, MADV_RANDOM);
+
+    fHeader = header;
+    fBase = base;
+    fSize = st.st_size;
+    fEventSize = eventSize;
+    return true;
+}
+
+
+
+void OverlayLibrary::Close()
+{
+    if(fBase)
+        munmap(fBase, fSize);
+    fBase = nullptr;
+    fSize = 0;
+    fHeader = {};
+}
+
+
+
+void OverlayLibrary::AddShifted(uint64_t event, int side, uint32_t channel, int32_t shift, float *wave) const
+{
+    const uint32_t channels = fHeader.fChannels;
+    const int32_t samplings = fHeader.fSamplings;
+    const char *begin = static_cast<const char*>(fBase) + sizeof(OverlayHeader) + event * fEventSize;
+
+    uint32_t w = side * channels + channel;
+    float scale;
+    memcpy(&scale, begin + w * sizeof(float), sizeof(float));
+    if(scale == 0)
+        return;
+    const int16_t *samples = reinterpret_cast<const int16_t*>(begin + 2 * channels * sizeof(float)) + (size_t) w * samplings;
+
+    // wave[bin] += scale * samples[bin - shift] where both are in the window
+    int32_t first = max(shift, 0);
+    int32_t last = min(samplings, samplings + shift);
+    float *dst = wave + first;
+    const int16_t *src = samples + first - shift;
+    for(int32_t n = 0; n < last - first; n++)
+        dst[n] += scale * src[n];
+}
@@ -0,0 +1,109 @@
+/**
+ * @file photoncache.cc
+ * @brief Definition of the photon-level cache
+ */
+#include "photoncache.hh"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+#include <TNamed.h>
+#include <TParameter.h>
+
+using namespace std;
+
+
+void PhotonColumns::Pack(const vector<Photon> &photons, Int_t nPars)
+{
+    // Sorted columns compress better and are replayed channel by channel
+    vector<UInt_t> order(photons.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&photons](UInt_t a, UInt_t b)
+    {
+        return (photons[a].fChannel != photons[b].fChannel) ? photons[a].fChannel < photons[b].fChannel : photons[a].fTime < photons[b].fTime;
+    });
+
+    fChannel.resize(photons.size());
+    fTime.resize(photons.size());
+    fPars.resize(photons.size() * nPars);
+    for(size_t j = 0; j < order.size(); j++)
+    {
+        const Photon &ph = photons[order[j]];
+        fChannel[j] = ph.fChannel;
+        fTime[j] = ph.fTime;
+        copy_n(ph.fPars, nPars, fPars.begin() + j * nPars);
+    }
+}
+
+
+
+void PhotonColumns::Unpack(vector<Photon> &photons, Int_t nPars) const
+{
+    photons.resize(fChannel.size());
+    for(size_t j = 0; j < fChannel.size(); j++)
+    {
+        photons[j].fChannel = fChannel[j];
+        photons[j].fTime = fTime[j];
+        copy_n(fPars.begin() + j * nPars, nPars, photons[j].fPars);
+    }
+}
+
+
+
+Bool_t PhotonCache::Open(const char *filename)
+{
+    Close();
+
+    fFile.reset(TFile::Open(filename, "READ"));
+    if(!fFile || fFile->IsZombie())
+    {
+        cerr << "Can't open the photon cache " << filename << endl;
+        fFile.reset();
+        return false;
+    }
+
+    fTree = fFile->Get<TTree>("lyso_photons");
+    auto *model = fFile->Get<TNamed>("PulseModel");
+    auto *nPars = fFile->Get<TParameter<Int_t>>("NPulsePars");
+    if(!fTree || !model || !nPars)
+    {
+        cerr << "No lyso_photons tree in " << filename << ": it must be the output of a run with Save photons = true" << endl;
+        fTree = nullptr;
+        fFile.reset();
+        return false;
+    }
+    fPulseModel = model->GetTitle();
+    fNPars = nPars->GetVal();
+    delete model;
+    delete nPars;
+
+    fTree->SetBranchAddress("Event", &fEvent);
+    fTree->SetBranchAddress("Ch_F", &fChannel_F);
+    fTree->SetBranchAddress("T_F", &fTime_F);
+    fTree->SetBranchAddress("Pars_F", &fPars_F);
+    fTree->SetBranchAddress("Ch_B", &fChannel_B);
+    fTree->SetBranchAddress("T_B", &fTime_B);
+    fTree->SetBranchAddress("Pars_B", &fPars_B);
+
+    return true;
+}
+
+
+
+void PhotonCache::Close()
+{
+    if(fTree)
+        fTree->ResetBranchAddresses();
+    fTree = nullptr;
+    fFile.reset();
+}
+
+
+
+void PhotonCache::GetEntry(Long64_t entry, vector<Photon> &photons_F, vector<Photon> &photons_B)
+{
+    fTree->GetEntry(entry);
+    fColumns_F.Unpack(photons_F, fNPars);
+    fColumns_B.Unpack(photons_B, fNPars);
+}
@@ -0,0 +1,118 @@
+/**
+ * @file resampler.cc
+ * @brief Definition of the methods of the class Resampler
+ */
+#include "resampler.hh"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+namespace
+{
+    constexpr double RESAMPLER_ROLLOFF = 0.9; // Cut-off as a fraction of the lower Nyquist frequency
+    constexpr double RESAMPLER_TOLERANCE = 1e-6; // Relative error accepted on the rate ratio
+}
+
+
+
+bool Resampler::Init(double rateIn, double rateOut, int nOut)
+{
+    // Smallest fraction L/M equal to rateOut/rateIn
+    double ratio = rateOut / rateIn;
+    fL = 0;
+    for(int l = 1; l <= kMaxPhases && fL == 0; l++)
+    {
+        long m = lround(l / ratio);
+        if(m > 0 && fabs((double) l / m - ratio) < RESAMPLER_TOLERANCE * ratio)
+        {
+            fL = l;
+            fM = m;
+        }
+    }
+    if(fL == 0)
+        return false;
+
+    fRateIn = rateIn;
+    fCutoff = RESAMPLER_ROLLOFF * min(1., ratio);
+    fHalfTaps = (int) ceil(kHalfLength / min(1., ratio));
+    fNOut = nOut;
+    fInputLength = (int) (((long) (nOut - 1) * fM) / fL) + 2 * fHalfTaps + 1;
+
+    // Taps of each phase, normalized to unit gain at DC
+    fCoefficients.assign(fL * 2 * fHalfTaps, 0);
+    for(int p = 0; p < fL; p++)
+    {
+        double frac = (double) p / fL;
+        float *c = fCoefficients.data() + p * 2 * fHalfTaps;
+        double sum = 0;
+        for(int i = 0; i < 2 * fHalfTaps; i++)
+        {
+            c[i] = Kernel(frac + fHalfTaps - 1 - i);
+            sum += c[i];
+        }
+        for(int i = 0; i < 2 * fHalfTaps; i++)
+            c[i] /= sum;
+    }
+
+    return true;
+}
+
+
+
+double Resampler::Kernel(double x) const
+{
+    if(fabs(x) >= fHalfTaps)
+        return 0;
+
+    // Sinc at the cut-off, Blackman window over the taps
+    double arg = M_PI * fCutoff * x;
+    double sinc = (fabs(arg) < 1e-9) ? 1. : sin(arg) / arg;
+    double w = 0.42 + 0.5 * cos(M_PI * x / fHalfTaps) + 0.08 * cos(2 * M_PI * x / fHalfTaps);
+    return fCutoff * sinc * w;
+}
+
+
+
+void Resampler::Process(const float *in, float *out) const
+{
+    // The output sample n is at input position n*M/L + fHalfTaps
+    for(int n = 0; n < fNOut; n++)
+    {
+        long position = (long) n * fM;
+        int base = (int) (position / fL) + fHalfTaps;
+        const float *c = fCoefficients.data() + (position % fL) * 2 * fHalfTaps;
+        const float *x = in + base - fHalfTaps + 1;
+
+        float sum = 0;
+        for(int i = 0; i < 2 * fHalfTaps; i++)
+            sum += c[i] * x[i];
+        out[n] = sum;
+    }
+}
+
+
+
+void Resampler::ProcessAt(const float *in, const float *times, float *out) const
+{
+    for(int n = 0; n < fNOut; n++)
+    {
+        double position = times[n] * fRateIn + fHalfTaps;
+        int base = (int) floor(position);
+        double frac = position - base;
+
+        double sum = 0, norm = 0;
+        for(int i = 0; i < 2 * fHalfTaps; i++)
+        {
+            int j = base - fHalfTaps + 1 + i;
+            if(j < 0 || j >= fInputLength)
+                continue;
+            double c = Kernel(frac + fHalfTaps - 1 - i);
+            sum += c * in[j];
+            norm += c;
+        }
+        out[n] = (norm != 0) ? sum / norm : 0;
+    }
+}
@@ -0,0 +1,147 @@
+/**
+ * @file rntuplesink.cc
+ * @brief Definition of the methods of the class RNTupleSink
+ */
+#include "rntuplesink.hh"
+
+#include <memory>
+
+#include <RVersion.h>
+#include <TFile.h>
+
+// The RNTuple classes left the Experimental namespace in ROOT 6.36
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,36,0)
+#define BARTENDER_HAS_RNTUPLE
+#include <ROOT/RField.hxx>
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+namespace RNTupleAPI = ROOT;
+#elif ROOT_VERSION_CODE >= ROOT_VERSION(6,32,0)
+#define BARTENDER_HAS_RNTUPLE
+#include <ROOT/RField.hxx>
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+namespace RNTupleAPI = ROOT::Experimental;
+#endif
+
+using namespace std;
+
+
+#ifdef BARTENDER_HAS_RNTUPLE
+
+struct RNTupleSink::Impl
+{
+    unique_ptr<RNTupleAPI::RNTupleWriter> fWriter;
+    unique_ptr<RNTupleAPI::REntry> fEntry; /**< Bare entry, bound to the waveforms of the caller at each Fill() */
+    Int_t fEvent = 0;
+    Bool_t fIsTimesWritten = false;
+};
+
+
+
+Bool_t RNTupleSink::IsAvailable()
+{
+    return true;
+}
+
+
+
+Bool_t RNTupleSink::Open(TFile *file, Int_t compression)
+{
+    fFile = file;
+    fCompression = compression;
+
+    // A bare model owns no values: the fields are bound to the waveforms of
+    // the caller, which are written without a copy
+    auto model = RNTupleAPI::RNTupleModel::CreateBare();
+    model->AddField(make_unique<RNTupleAPI::RField<Int_t>>("Event"));
+    model->AddField(make_unique<RNTupleAPI::RField<vector<vector<Float_t>>>>("Front"));
+    model->AddField(make_unique<RNTupleAPI::RField<vector<vector<Float_t>>>>("Back"));
+
+    RNTupleAPI::RNTupleWriteOptions options;
+    options.SetCompression(fCompression);
+    fImpl = new Impl();
+    fImpl->fWriter = RNTupleAPI::RNTupleWriter::Append(move(model), "lyso_wfs", *fFile, options);
+    fImpl->fEntry = fImpl->fWriter->GetModel().CreateBareEntry();
+    fImpl->fEntry->BindRawPtr("Event", &fImpl->fEvent);
+
+    return true;
+}
+
+
+
+void RNTupleSink::SetTimes(const vector<vector<Float_t>> &times_F, const vector<vector<Float_t>> &times_B)
+{
+    if(!fImpl || fImpl->fIsTimesWritten)
+        return;
+
+    auto model = RNTupleAPI::RNTupleModel::Create();
+    auto time_F = model->MakeField<vector<vector<Float_t>>>("Time_F");
+    auto time_B = model->MakeField<vector<vector<Float_t>>>("Time_B");
+
+    RNTupleAPI::RNTupleWriteOptions options;
+    options.SetCompression(fCompression);
+    auto writer = RNTupleAPI::RNTupleWriter::Append(move(model), "lyso_wfs_times", *fFile, options);
+    *time_F = times_F;
+    *time_B = times_B;
+    writer->Fill();
+
+    // The writer commits the RNTuple when destroyed
+    fImpl->fIsTimesWritten = true;
+}
+
+
+
+void RNTupleSink::Fill(Int_t event, const vector<vector<Float_t>> &front, const vector<vector<Float_t>> &back)
+{
+    // The writer only reads the bound values
+    fImpl->fEvent = event;
+    fImpl->fEntry->BindRawPtr("Front", const_cast<vector<vector<Float_t>>*>(&front));
+    fImpl->fEntry->BindRawPtr("Back", const_cast<vector<vector<Float_t>>*>(&back));
+    fImpl->fWriter->Fill(*fImpl->fEntry);
+    fEntries++;
+}
+
+
+
+void RNTupleSink::Close()
+{
+    delete fImpl;
+    fImpl = nullptr;
+}
+
+#else
+
+struct RNTupleSink::Impl {};
+
+
+
+Bool_t RNTupleSink::IsAvailable()
+{
+    return false;
+}
+
+
+
+Bool_t RNTupleSink::Open(TFile*, Int_t)
+{
+    return false;
+}
+
+
+
+void RNTupleSink::SetTimes(const vector<vector<Float_t>>&, const vector<vector<Float_t>>&) {}
+
+
+
+void RNTupleSink::Fill(Int_t, const vector<vector<Float_t>>&, const vector<vector<Float_t>>&) {}
+
+
+
+void RNTupleSink::Close()
+{
+    delete fImpl;
+    fImpl = nullptr;
+}
+
+#endif
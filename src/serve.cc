@@ -0,0 +1,282 @@
+/**
+ * @file serve.cc
+ * @brief Definition of the function @ref Bartender_Serve()
+ */
+#include "serve.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <TROOT.h>
+
+#include "configure.hh"
+#include "eventloop.hh"
+
+using namespace std;
+
+
+namespace
+{
+    constexpr Int_t SERVE_POLL_MS = 500; // Interval between two scans of the spool directory
+
+    atomic<bool> gIsStopping(false);
+
+    void StopOnSignal(int)
+    {
+        gIsStopping = true;
+    }
+
+    // Job read from the spool directory
+    struct Job
+    {
+        string fPath; // Spool file, without the .running suffix
+        string fInput;
+        string fOutput;
+        Long64_t fFirst = 0;
+        Long64_t fLast = -1;
+    };
+
+    // Writes the status of a job next to its spool file
+    void WriteStatus(const Job &job, const string &status, Long64_t entries, Double_t seconds, const string &message = "")
+    {
+        string path = job.fPath.substr(0, job.fPath.size() - 4) + ".status";
+        string temporary = path + ".tmp";
+        {
+            ofstream file(temporary);
+            file << "Status = " << status << '\n';
+            file << "Input = " << job.fInput << '\n';
+            file << "Output = " << job.fOutput << '\n';
+            file << "Entries = " << entries << '\n';
+            file << "Wall time = " << seconds << " s\n";
+            file << "Rate = " << (seconds > 0 ? entries / seconds : 0) << " events/s\n";
+            if(!message.empty())
+                file << "Message = " << message << '\n';
+        }
+        rename(temporary.c_str(), path.c_str());
+    }
+
+    Bool_t ReadJob(const string &path, Job &job)
+    {
+        ifstream file(path);
+        if(!file)
+            return false;
+
+        job.fPath = path;
+        string line;
+        try
+        {
+            while(getline(file, line))
+            {
+                if(line.find("Input =") != string::npos)
+                    job.fInput = extract_value(line, "Input =");
+                else if(line.find("Output =") != string::npos)
+                    job.fOutput = extract_value(line, "Output =");
+                else if(line.find("First entry =") != string::npos)
+                    job.fFirst = stoll(extract_value(line, "First entry ="));
+                else if(line.find("Last entry =") != string::npos)
+                    job.fLast = stoll(extract_value(line, "Last entry ="));
+            }
+        }
+        catch(const exception&)
+        {
+            return false;
+        }
+        return !job.fInput.empty();
+    }
+
+    // Seed of a job, from its input file and entry range (FNV-1a), so that a
+    // job gives the same output on any worker and after any other job
+    UInt_t JobSeed(const Job &job)
+    {
+        string key = job.fInput + ':' + to_string(job.fFirst) + ':' + to_string(job.fLast);
+        UInt_t hash = 2166136261u;
+        for(unsigned char c : key)
+            hash = (hash ^ c) * 16777619u;
+        return (hash == 0) ? 1 : hash; // 0 would seed from the clock
+    }
+
+    // Runs a job on a warm generator; returns the entries processed, or -1
+    Long64_t RunJob(BarLYSO *bar, Job &job, string &message)
+    {
+        McInput mc;
+        if(!mc.Open(job.fInput.c_str()))
+        {
+            message = "can't read the lyso tree of " + job.fInput;
+            return -1;
+        }
+
+        Long64_t last = (job.fLast < 0) ? mc.GetEntries() : min(job.fLast, mc.GetEntries());
+        Long64_t first = max(job.fFirst, 0LL);
+        if(first >= last)
+        {
+            message = "empty entry range";
+            return -1;
+        }
+
+        // Without an output, the name from the input followed by that of the job
+        bar->SetMCFilename(job.fInput.c_str());
+        if(job.fOutput.empty())
+        {
+            string output = bar->GetOutputFilename();
+            string name = job.fPath.substr(job.fPath.find_last_of('/') + 1);
+            job.fOutput = output.substr(0, output.size() - 5) + "_" + name.substr(0, name.size() - 4) + ".root";
+        }
+        bar->SetOutputFilename(job.fOutput);
+        bar->SetSeed(JobSeed(job));
+        bar->SetEvents(last - first);
+        if(!bar->OpenOutput())
+        {
+            message = "can't create the output file " + job.fOutput;
+            bar->CloseOutput();
+            return -1;
+        }
+        if(bar->IsFreeRunning())
+            bar->BeginFreeRunning();
+        bar->SetSamplingTimes();
+
+        Bartender_Loop(bar, mc, first, last, {}, nullptr, "");
+
+        bar->SaveBar();
+        bar->CloseOutput();
+        return last - first;
+    }
+}
+
+
+
+Int_t Bartender_Serve(const char *sipmFilename, const string &spoolDir, Int_t nWorkers)
+{
+    DIR *probe = opendir(spoolDir.c_str());
+    if(!probe)
+    {
+        cerr << "Can't read the spool directory " << spoolDir << endl;
+        return 1;
+    }
+    closedir(probe);
+
+    ROOT::EnableThreadSafety();
+    signal(SIGINT, StopOnSignal);
+    signal(SIGTERM, StopOnSignal);
+
+    // The costly part of the startup is paid once per worker
+    vector<BarLYSO*> bars;
+    for(Int_t i = 0; i < nWorkers; i++)
+    {
+        SiPM sipm;
+        BarLYSO *bar = new BarLYSO("", i);
+        Bartender_Configure(sipmFilename, bar, &sipm);
+        bar->SetParsDistro();
+        bars.push_back(bar);
+    }
+    cout << "BarSV>> Serving " << spoolDir << " with " << nWorkers << " workers" << endl;
+
+    mutex queueMutex;
+    condition_variable queueCondition;
+    deque<Job> queue;
+    Bool_t isDone = false;
+
+    auto worker = [&](Int_t id)
+    {
+        BarLYSO *bar = bars[id];
+        string prefix = "BarWT" + to_string(id) + ">> ";
+        while(true)
+        {
+            Job job;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueCondition.wait(lock, [&] { return isDone || !queue.empty(); });
+                if(queue.empty())
+                    return;
+                job = queue.front();
+                queue.pop_front();
+            }
+
+            WriteStatus(job, "running", 0, 0);
+            auto start = chrono::steady_clock::now();
+            string message;
+            Long64_t entries = RunJob(bar, job, message);
+            chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+
+            Bool_t isFailed = (entries < 0);
+            WriteStatus(job, isFailed ? "failed" : "done", max(entries, 0LL), seconds.count(), message);
+            string running = job.fPath + ".running";
+            rename(running.c_str(), (job.fPath + (isFailed ? ".failed" : ".done")).c_str());
+            cout << prefix << job.fPath << (isFailed ? " failed: " + message : " done in " + to_string(seconds.count()) + " s") << endl;
+        }
+    };
+
+    vector<thread> threads;
+    for(Int_t i = 0; i < nWorkers; i++)
+        threads.emplace_back(worker, i);
+
+    // Claim the new jobs in name order
+    string stopFile = spoolDir + "/stop";
+    struct stat st;
+    while(!gIsStopping && stat(stopFile.c_str(), &st) != 0)
+    {
+        vector<string> names;
+        if(DIR *dir = opendir(spoolDir.c_str()))
+        {
+            while(dirent *entry = readdir(dir))
+            {
+                string name = entry->d_name;
+                if(name.size() > 4 && name.compare(name.size() - 4, 4, ".job") == 0)
+                    names.push_back(name);
+            }
+            closedir(dir);
+        }
+        sort(names.begin(), names.end());
+
+        for(const string &name : names)
+        {
+            string path = spoolDir + "/" + name;
+            string running = path + ".running";
+            if(rename(path.c_str(), running.c_str()) != 0)
+                continue;
+
+            Job job;
+            if(!ReadJob(running, job))
+            {
+                job.fPath = path;
+                WriteStatus(job, "failed", 0, 0, "no Input, or an invalid entry, in the job");
+                rename(running.c_str(), (path + ".failed").c_str());
+                continue;
+            }
+            job.fPath = path;
+            WriteStatus(job, "queued", 0, 0);
+
+            lock_guard<mutex> lock(queueMutex);
+            queue.push_back(job);
+            queueCondition.notify_one();
+        }
+
+        this_thread::sleep_for(chrono::milliseconds(SERVE_POLL_MS));
+    }
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        isDone = true;
+    }
+    queueCondition.notify_all();
+    for(thread &t : threads)
+        t.join();
+    for(BarLYSO *bar : bars)
+        delete bar;
+    remove(stopFile.c_str());
+
+    cout << "BarSV>> Stopped" << endl;
+    return 0;
+}
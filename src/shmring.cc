@@ -0,0 +1,243 @@
+/**
+ * @file shmring.cc
+ * @brief Definition of the classes ShmProducer and ShmConsumer
+ */
+#include "shmring.hh"
+
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+namespace
+{
+    constexpr uint32_t SHM_MAGIC = 0x42415254; // "BART"
+
+    size_t TimesOffset() { return (sizeof(ShmRingHeader) + 63) & ~size_t(63); }
+
+    size_t SlotsOffset(const ShmRingHeader *header)
+    {
+        size_t timesSize = 2 * sizeof(float) * header->fChannels * header->fSamplings;
+        return (TimesOffset() + timesSize + 63) & ~size_t(63);
+    }
+
+    char *Slot(void *base, const ShmRingHeader *header, uint64_t index)
+    {
+        return static_cast<char*>(base) + SlotsOffset(header) + (index % header->fSlots) * header->fSlotSize;
+    }
+
+    // Spin briefly, then sleep: the waits are short when the two ends keep up
+    template<class Condition>
+    bool WaitFor(Condition condition, int timeoutMs)
+    {
+        auto start = chrono::steady_clock::now();
+        for(int spin = 0; !condition(); spin++)
+        {
+            if(spin < 1000)
+                this_thread::yield();
+            else
+            {
+                if(chrono::steady_clock::now() - start > chrono::milliseconds(timeoutMs))
+                    return false;
+                this_thread::sleep_for(chrono::microseconds(100));
+            }
+        }
+        return true;
+    }
+}
+
+
+
+bool ShmProducer::Open(const string &name, uint32_t slots, uint32_t channels, uint32_t samplings)
+{
+    fName = name;
+
+    size_t waveSize = sizeof(float) * channels * samplings;
+    uint64_t slotSize = (64 + 2 * waveSize + 63) & ~uint64_t(63);
+    size_t timesSize = 2 * waveSize;
+    fSize = ((TimesOffset() + timesSize + 63) & ~size_t(63)) + slots * slotSize;
+
+    // Replace any segment left by a crashed run
+    shm_unlink(fName.c_str());
+    int fd = shm_open(fName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0)
+        return false;
+    if(ftruncate(fd, fSize) != 0)
+    {
+        close(fd);
+        shm_unlink(fName.c_str());
+        return false;
+    }
+
+    fBase = mmap(nullptr, fSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(fBase == MAP_FAILED)
+    {
+        fBase = nullptr;
+        shm_unlink(fName.c_str());
+        return false;
+    }
+
+    fHeader = new (fBase) ShmRingHeader();
+    fHeader->fSlots = slots;
+    fHeader->fChannels = channels;
+    fHeader->fSamplings = samplings;
+    fHeader->fSlotSize = slotSize;
+    fHeader->fHead.store(0);
+    fHeader->fTail.store(0);
+    fHeader->fIsDone.store(0);
+    atomic_thread_fence(memory_order_release);
+    fHeader->fMagic = SHM_MAGIC;
+
+    return true;
+}
+
+
+
+void ShmProducer::SetTimes(const vector<vector<float>> &times_F, const vector<vector<float>> &times_B)
+{
+    float *dest = reinterpret_cast<float*>(static_cast<char*>(fBase) + TimesOffset());
+    for(const auto *times : {&times_F, &times_B})
+    {
+        for(uint32_t ch = 0; ch < fHeader->fChannels; ch++)
+        {
+            memcpy(dest, (*times)[ch].data(), sizeof(float) * fHeader->fSamplings);
+            dest += fHeader->fSamplings;
+        }
+    }
+}
+
+
+
+bool ShmProducer::Publish(int32_t event, const vector<vector<float>> &front, const vector<vector<float>> &back, int timeoutMs)
+{
+    uint64_t head = fHeader->fHead.load(memory_order_relaxed);
+
+    // Back-pressure: wait for the consumer to free a slot
+    auto isFree = [&]() { return head - fHeader->fTail.load(memory_order_acquire) < fHeader->fSlots; };
+    if(!WaitFor(isFree, timeoutMs))
+        return false;
+
+    char *slot = Slot(fBase, fHeader, head);
+    memcpy(slot, &event, sizeof(event));
+    float *dest = reinterpret_cast<float*>(slot + 64);
+    for(const auto *waves : {&front, &back})
+    {
+        for(uint32_t ch = 0; ch < fHeader->fChannels; ch++)
+        {
+            // Masked channels are empty: published as zeros
+            if((*waves)[ch].empty())
+                memset(dest, 0, sizeof(float) * fHeader->fSamplings);
+            else
+                memcpy(dest, (*waves)[ch].data(), sizeof(float) * fHeader->fSamplings);
+            dest += fHeader->fSamplings;
+        }
+    }
+
+    fHeader->fHead.store(head + 1, memory_order_release);
+    return true;
+}
+
+
+
+void ShmProducer::Close(int timeoutMs)
+{
+    if(!fHeader)
+        return;
+
+    fHeader->fIsDone.store(1, memory_order_release);
+    WaitFor([&]() { return fHeader->fTail.load(memory_order_acquire) == fHeader->fHead.load(memory_order_relaxed); }, timeoutMs);
+
+    munmap(fBase, fSize);
+    shm_unlink(fName.c_str());
+    fBase = nullptr;
+    fHeader = nullptr;
+}
+
+
+
+bool ShmConsumer::Open(const string &name, int timeoutMs)
+{
+    int fd = -1;
+    auto isCreated = [&]()
+    {
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+        struct stat st;
+        if(fd >= 0 && fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(ShmRingHeader))
+        {
+            fSize = st.st_size;
+            return true;
+        }
+        if(fd >= 0) close(fd);
+        return false;
+    };
+    if(!WaitFor(isCreated, timeoutMs))
+        return false;
+
+    fBase = mmap(nullptr, fSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(fBase == MAP_FAILED)
+    {
+        fBase = nullptr;
+        return false;
+    }
+
+    fHeader = static_cast<ShmRingHeader*>(fBase);
+    if(!WaitFor([&]() { return fHeader->fMagic == SHM_MAGIC; }, timeoutMs))
+    {
+        Close();
+        return false;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    return true;
+}
+
+
+
+bool ShmConsumer::Acquire(ShmEventView &view, int timeoutMs)
+{
+    uint64_t tail = fHeader->fTail.load(memory_order_relaxed);
+    auto isReady = [&]() { return fHeader->fHead.load(memory_order_acquire) > tail || fHeader->fIsDone.load(memory_order_acquire); };
+    if(!WaitFor(isReady, timeoutMs) || fHeader->fHead.load(memory_order_acquire) == tail)
+        return false;
+
+    const char *slot = Slot(fBase, fHeader, tail);
+    const float *times = reinterpret_cast<const float*>(static_cast<const char*>(fBase) + TimesOffset());
+    size_t waveLength = fHeader->fChannels * fHeader->fSamplings;
+
+    memcpy(&view.fEvent, slot, sizeof(view.fEvent));
+    view.fChannels = fHeader->fChannels;
+    view.fSamplings = fHeader->fSamplings;
+    view.fFront = reinterpret_cast<const float*>(slot + 64);
+    view.fBack = view.fFront + waveLength;
+    view.fTimes_F = times;
+    view.fTimes_B = times + waveLength;
+
+    return true;
+}
+
+
+
+void ShmConsumer::Release()
+{
+    fHeader->fTail.fetch_add(1, memory_order_release);
+}
+
+
+
+void ShmConsumer::Close()
+{
+    if(fBase)
+        munmap(fBase, fSize);
+    fBase = nullptr;
+    fHeader = nullptr;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file sipmnoise.cc
+ * @brief Definition of the methods of the class BarLYSO for the dark counts,
+ * crosstalk and afterpulses of the SiPMs
+ */
+#include "bar.hh"
+
+#include <algorithm>
+
+using namespace std;
+using namespace TMath;
+
+
+namespace
+{
+    constexpr Double_t SIPM_NOISE_MARGIN = 200; // Time [ns] before the window in which a dark count still reaches it
+    constexpr Double_t NOISE_PULSE_LENGTH = 20; // Support of a noise pulse, in units of its longest time constant
+}
+
+
+
+template<class Pulse>
+void BarLYSO::AddNoiseKernel(vector<Float_t> &wave, const vector<Float_t> &times, const Double_t *starts, const Double_t *pars, Int_t nPulses)
+{
+    const Int_t samplings = wave.size();
+    const Float_t *t = times.data();
+    Float_t *w = wave.data();
+
+    // The pulses are sorted, so the first bin after the start only moves
+    // forward; the waveform is zero before it
+    Int_t first = 0;
+    for(Int_t j = 0; j < nPulses; j++)
+    {
+        const Double_t *p = pars + j * MAX_PULSE_PARS;
+        const Double_t timePhel = starts[j] + ZERO_TIME_BIN;
+        const Double_t end = timePhel + NOISE_PULSE_LENGTH * Pulse::Duration(p);
+
+        while(first < samplings && t[first] <= timePhel)
+            first++;
+        for(Int_t bin = first; bin < samplings && t[bin] < end; bin++)
+            w[bin] += Pulse::Eval(t[bin], p, timePhel);
+    }
+}
+
+template void BarLYSO::AddNoiseKernel<TwoExpPulse>(vector<Float_t>&, const vector<Float_t>&, const Double_t*, const Double_t*, Int_t);
+template void BarLYSO::AddNoiseKernel<ThreeExpPulse>(vector<Float_t>&, const vector<Float_t>&, const Double_t*, const Double_t*, Int_t);
+template void BarLYSO::AddNoiseKernel<FastSlowPulse>(vector<Float_t>&, const vector<Float_t>&, const Double_t*, const Double_t*, Int_t);
+
+
+
+void BarLYSO::AddSiPMNoise(Bool_t isFront)
+{
+    const vector<Char_t> &mask = isFront ? fMask_F : fMask_B;
+
+    // Crosstalk cascades: each crosstalk pulse can fire another cell
+    const Double_t crosstalkMean = (fSiPMNoise.fCrosstalk < 1) ? fSiPMNoise.fCrosstalk / (1 - fSiPMNoise.fCrosstalk) : 0;
+    const Bool_t isApprox = fApproxThreshold > 0 && !fIsReference && !fResampler;
+
+    for(Int_t ch = 0; ch < fChannels; ch++)
+    {
+        vector<Double_t> &avalanches = fAvalanches[ch];
+        if(!mask[ch])
+        {
+            avalanches.clear();
+            continue;
+        }
+        const size_t nPhotons = avalanches.size();
+
+        // Dark counts over the window, in the time of the photons
+        const vector<Float_t> &times = GetChannelTimes(isFront, ch);
+        if(fSiPMNoise.fDarkRate > 0)
+        {
+            Double_t first = times.front() - ZERO_TIME_BIN - SIPM_NOISE_MARGIN;
+            Double_t last = times.back() - ZERO_TIME_BIN;
+            Int_t nDark = fRandPars->Poisson(fSiPMNoise.fDarkRate * 1.e-3 * (last - first));
+            for(Int_t j = 0; j < nDark; j++)
+                avalanches.push_back(fRandPars->Uniform(first, last));
+        }
+
+        // Prompt crosstalk of the photons and of the dark counts
+        const Int_t nPrimaries = avalanches.size();
+        if(crosstalkMean > 0 && nPrimaries > 0)
+        {
+            Int_t nCrosstalk = fRandPars->Poisson(crosstalkMean * nPrimaries);
+            for(Int_t j = 0; j < nCrosstalk; j++)
+                avalanches.push_back(avalanches[fRandPars->Integer(nPrimaries)]);
+        }
+
+        // Afterpulses of all the avalanches
+        const Int_t nAvalanches = avalanches.size();
+        if(fSiPMNoise.fAfterpulse > 0 && nAvalanches > 0)
+        {
+            Int_t nAfterpulses = fRandPars->Poisson(fSiPMNoise.fAfterpulse * nAvalanches);
+            for(Int_t j = 0; j < nAfterpulses; j++)
+                avalanches.push_back(avalanches[fRandPars->Integer(nAvalanches)] + fRandPars->Exp(fSiPMNoise.fAfterpulseTau));
+        }
+
+        // Only the noise pulses are synthesized here
+        const Int_t nNoise = avalanches.size() - nPhotons;
+        if(nNoise > 0 && isApprox && nNoise > fApproxThreshold)
+        {
+            avalanches.erase(avalanches.begin(), avalanches.begin() + nPhotons);
+            ActivateChannel(isFront, ch);
+            AddApproxChannel(isFront ? fFront[ch] : fBack[ch], times, avalanches);
+        }
+        else if(fIsReference)
+        {
+            for(size_t j = nPhotons; j < avalanches.size(); j++)
+            {
+                Double_t pars[MAX_PULSE_PARS];
+                SamplePulsePars(pars);
+                if(isFront) AddFrontPhel(ch, pars, avalanches[j]);
+                else AddBackPhel(ch, pars, avalanches[j]);
+            }
+        }
+        else if(nNoise > 0)
+        {
+            sort(avalanches.begin() + nPhotons, avalanches.end());
+            fNoisePars.resize(nNoise * MAX_PULSE_PARS);
+            for(Int_t j = 0; j < nNoise; j++)
+                SamplePulsePars(&fNoisePars[j * MAX_PULSE_PARS]);
+
+            // On the synthesis grid if set, as the photons
+            ActivateChannel(isFront, ch);
+            vector<Float_t> *wave;
+            if(fResampler)
+            {
+                wave = isFront ? &fFine_F[ch] : &fFine_B[ch];
+                (isFront ? fIsFineUsed_F : fIsFineUsed_B)[ch] = true;
+            }
+            else
+                wave = isFront ? &fFront[ch] : &fBack[ch];
+            (this->*fAddNoiseKernel)(*wave, fResampler ? fFineTimes : times, avalanches.data() + nPhotons, fNoisePars.data(), nNoise);
+        }
+        avalanches.clear();
+    }
+}
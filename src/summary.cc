@@ -25,7 +25,7 @@ std::string summary_extract_value(const std::string& line, const std::string& ke
 
 
 
-void Bartender_Summary(const std::string &macrofile, int MCID, double duration) {
+void Bartender_Summary(const std::string &macrofile, int MCID, double duration, const std::string &notes) {
     bool isConstantBins = true, isShaping = false;
 
     std::ofstream outfile("Bartender_summaries.txt", std::ios::app);
@@ -137,9 +137,68 @@ void Bartender_Summary(const std::string &macrofile, int MCID, double duration)
         if(!noise_value.empty())
             outfile << "Noise (sigma): " << noise_value << '\n';
     }
+    else if(line.find("Pulse model =") != std::string::npos)
+    {
+        std::string pulse_value = summary_extract_value(line, "Pulse model =");
+        if(!pulse_value.empty())
+            outfile << "Pulse model: " << pulse_value << '\n';
+    }
+    else if(line.find("Jitter pool =") != std::string::npos)
+    {
+        std::string pool_value = summary_extract_value(line, "Jitter pool =");
+        if(!pool_value.empty() && std::stoi(pool_value) > 0)
+            outfile << "Jitter pool: " << pool_value << '\n';
+    }
+    else if(line.find("Synthesis rate =") != std::string::npos)
+    {
+        std::string synthesis_value = summary_extract_value(line, "Synthesis rate =");
+        if(!synthesis_value.empty() && synthesis_value != "off")
+            outfile << "Synthesis rate: " << synthesis_value << '\n';
+    }
+    else if(line.find("Dark count rate =") != std::string::npos || line.find("Crosstalk probability =") != std::string::npos
+            || line.find("Afterpulse probability =") != std::string::npos)
+    {
+        std::string key = line.substr(0, line.find(" ="));
+        std::string noise_value = summary_extract_value(line, key + " =");
+        if(!noise_value.empty() && std::stod(noise_value) > 0)
+            outfile << key << ": " << noise_value << '\n';
+    }
+    else if(line.find("Calibration table =") != std::string::npos)
+    {
+        std::string table_value = summary_extract_value(line, "Calibration table =");
+        if(!table_value.empty() && table_value != "none")
+            outfile << "Calibration table: " << table_value << '\n';
+    }
+    else if(line.find("ADC range =") != std::string::npos)
+    {
+        std::string range_value = summary_extract_value(line, "ADC range =");
+        if(!range_value.empty() && range_value != "none")
+            outfile << "ADC range: " << range_value << '\n';
+    }
+    else if(line.find("Free-running rate =") != std::string::npos)
+    {
+        std::string rate_value = summary_extract_value(line, "Free-running rate =");
+        if(!rate_value.empty() && std::stod(rate_value) > 0)
+            outfile << "Free-running rate: " << rate_value << '\n';
+    }
+    else if(line.find("Front channels:") != std::string::npos || line.find("Back channels:") != std::string::npos)
+    {
+        std::string key = line.substr(0, line.find(':') + 1);
+        std::string channels_value = summary_extract_value(line, key);
+        if(!channels_value.empty() && channels_value != "all")
+            outfile << key << " " << channels_value << '\n';
+    }
+    else if(line.find("Compression =") != std::string::npos)
+    {
+        std::string compression_value = summary_extract_value(line, "Compression =");
+        if(!compression_value.empty())
+            outfile << "Compression: " << compression_value << '\n';
+    }
 }
 
 
     run_file.close();
+    if(!notes.empty())
+        outfile << '\n' << notes;
     outfile << "\n########################################################\n\n";
 }
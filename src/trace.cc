@@ -0,0 +1,151 @@
+/**
+ * @file trace.cc
+ * @brief Definition of the per-event timeline tracing
+ */
+#include "trace.hh"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+
+
+namespace
+{
+    // Interval of a stage
+    struct TraceEvent
+    {
+        const char *fName;
+        int64_t fBegin;
+        int64_t fEnd;
+        Long64_t fEvent;
+        Long64_t fPhotons;
+    };
+
+    // Intervals of one thread, written only by it
+    struct ThreadBuffer
+    {
+        Int_t fThread;
+        vector<TraceEvent> fEvents;
+    };
+
+    string gFilename;
+    Int_t gProcessID = -1;
+
+    // The list is locked only when a thread records its first interval
+    mutex gBuffersMutex;
+    vector<unique_ptr<ThreadBuffer>> gBuffers;
+    thread_local ThreadBuffer *tBuffer = nullptr;
+}
+
+
+Bool_t Trace::gIsEnabled = false;
+
+
+
+void Trace::Start(const string &filename, Int_t processID)
+{
+    gFilename = filename;
+    gProcessID = processID;
+    gIsEnabled = true;
+}
+
+
+
+void Trace::Record(const char *name, int64_t begin, int64_t end, Long64_t event, Long64_t photons)
+{
+    if(!tBuffer)
+    {
+        lock_guard<mutex> lock(gBuffersMutex);
+        gBuffers.push_back(make_unique<ThreadBuffer>());
+        tBuffer = gBuffers.back().get();
+        tBuffer->fThread = gBuffers.size() - 1;
+        tBuffer->fEvents.reserve(1 << 16);
+    }
+
+    tBuffer->fEvents.push_back({name, begin, end, event, photons});
+}
+
+
+
+void Trace::Stop()
+{
+    if(!gIsEnabled)
+        return;
+    gIsEnabled = false;
+
+    ofstream file(gFilename);
+    if(!file)
+    {
+        cerr << "Can't write the trace " << gFilename << endl;
+        return;
+    }
+
+    // Single process and workers of bartenderMT are the processes of the
+    // timeline, with the names used in the log
+    Int_t pid = (gProcessID < 0) ? 0 : gProcessID;
+    string processName = (gProcessID < 0) ? "BarST" : "BarWT" + to_string(gProcessID);
+
+    lock_guard<mutex> lock(gBuffersMutex);
+    file << "{\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":0,\"args\":{\"name\":\"" << processName << "\"}}";
+    char line[256];
+    for(const auto &buffer : gBuffers)
+    {
+        for(const TraceEvent &ev : buffer->fEvents)
+        {
+            // Timestamps and durations in us
+            Int_t n = snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"bartender\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"event\":%lld",
+                               ev.fName, pid, buffer->fThread, ev.fBegin / 1.e3, (ev.fEnd - ev.fBegin) / 1.e3, (long long) ev.fEvent);
+            file.write(line, n);
+            if(ev.fPhotons >= 0)
+                file << ",\"photons\":" << ev.fPhotons;
+            file << "}}";
+        }
+        buffer->fEvents.clear();
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    cout << "Trace written to " << gFilename << endl;
+}
+
+
+
+Bool_t Trace::Merge(const vector<string> &inputs, const string &output)
+{
+    ofstream file(output);
+    Bool_t isFirst = true;
+    Bool_t isAnyRead = false;
+
+    // Every event of the traces written by Stop() is on its own line
+    file << "{\"traceEvents\":[\n";
+    for(const string &input : inputs)
+    {
+        ifstream in(input);
+        if(!in)
+        {
+            cerr << "Can't read the trace " << input << endl;
+            continue;
+        }
+        isAnyRead = true;
+
+        string line;
+        while(getline(in, line))
+        {
+            if(line.compare(0, 8, "{\"name\":") != 0)
+                continue;
+            if(line.back() == ',')
+                line.pop_back();
+            file << (isFirst ? "" : ",\n") << line;
+            isFirst = false;
+        }
+        in.close();
+        remove(input.c_str());
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    return isAnyRead;
+}
@@ -0,0 +1,255 @@
+/**
+ * @file validate.cc
+ * @brief Definition of the main function of bartender_validate.
+ */
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+
+#include <TH1D.h>
+#include <TMath.h>
+#include <TRandom3.h>
+
+#include "globals.hh"
+#include "configure.hh"
+#include "bar.hh"
+#include "SiPM.hh"
+#include "features.hh"
+
+
+using namespace std;
+
+
+/**
+ * @brief Seeded synthetic hit arrays of one event.
+ */
+struct SyntheticEvent
+{
+    vector<Int_t> fCh_F, fCh_B;
+    vector<Double_t> fT_F, fT_B;
+};
+
+
+/**
+ * @brief Estimators of the channels with at least one photon, for the
+ * distribution comparison.
+ */
+struct Estimators
+{
+    vector<Double_t> fCharge, fAmplitude, fCFTime;
+};
+
+
+SyntheticEvent GenerateEvent(TRandom3 &rand, Double_t meanPhotons, Int_t channels)
+{
+    const Double_t tauScint = 40.; // LYSO decay time [ns]
+    SyntheticEvent ev;
+    for(auto side : {make_pair(&ev.fCh_F, &ev.fT_F), make_pair(&ev.fCh_B, &ev.fT_B)})
+    {
+        Int_t nHits = rand.Poisson(meanPhotons);
+        for(Int_t j = 0; j < nHits; j++)
+        {
+            side.first->push_back(rand.Integer(channels));
+            side.second->push_back(rand.Exp(tauScint));
+        }
+    }
+    return ev;
+}
+
+
+void CollectEstimators(BarLYSO *bar, const SyntheticEvent &ev, const FeatureSettings &settings, SideFeatures &features, Estimators &est)
+{
+    for(Int_t side = 0; side < 2; side++)
+    {
+        const auto &waves = (side == 0) ? bar->GetFront() : bar->GetBack();
+        const auto &channels = (side == 0) ? ev.fCh_F : ev.fCh_B;
+
+        vector<Bool_t> isHit(bar->GetChannels(), false);
+        for(Int_t ch : channels) isHit[ch] = true;
+
+        for(Int_t ch = 0; ch < bar->GetChannels(); ch++)
+        {
+            if(!isHit[ch]) continue;
+            ExtractFeatures(waves[ch].data(), bar->GetChannelTimes(side == 0, ch).data(), bar->GetSamplings(), settings, features, ch);
+            est.fCharge.push_back(features.fCharge[ch]);
+            est.fAmplitude.push_back(features.fAmplitude[ch]);
+            est.fCFTime.push_back(features.fCFTime[ch]);
+        }
+    }
+}
+
+
+void Synthesize(BarLYSO *bar, Int_t event, const SyntheticEvent &ev)
+{
+    bar->InitializeBaselines(event);
+    bar->SetFrontWaveforms(ev.fCh_F.size(), ev.fCh_F.data(), ev.fT_F.data());
+    bar->SetBackWaveforms(ev.fCh_B.size(), ev.fCh_B.data(), ev.fT_B.data());
+    bar->SaveEvent();
+}
+
+
+BarLYSO *CreateBar(const char *sipmFilename, Bool_t isReference, UInt_t seed)
+{
+    SiPM sipm;
+    BarLYSO *bar = new BarLYSO();
+    Bartender_Configure(sipmFilename, bar, &sipm);
+    bar->SetReferenceMode(isReference);
+    bar->SetSeed(seed);
+    bar->SetParsDistro();
+    bar->SetSamplingTimes();
+    return bar;
+}
+
+
+/**
+ * @brief Main of bartender_validate.
+ *
+ * It checks a synthesis engine (the one selected by the macro file) against
+ * the plain scalar reference implementation (BarLYSO::SetReferenceMode()) on
+ * identical seeded synthetic events. The first check compares the output
+ * samples channel by channel within absolute and relative tolerances, and is
+ * meaningful for engines that are meant to be exact. The second one compares
+ * the distributions of charge, amplitude and constant-fraction time of the hit
+ * channels, obtained with independent seeds, with Kolmogorov-Smirnov and
+ * \f$ \chi^2 \f$ tests. The results are written in a report file, and the exit
+ * code is non-zero if any check fails.
+ */
+int main(int argc, char** argv)
+{
+    const string usage = string("Usage: ") + argv[0] + " sipmFilename [-n events] [-s seed] [--photons mean] [--abs-tol x] [--rel-tol x] [--alpha p] [-o report]";
+    if(argc < 2)
+    {
+        cerr << usage << endl;
+        return 1;
+    }
+
+    const char *sipmFilename = argv[1];
+    Int_t nEvents = 200;
+    UInt_t seed = 12345;
+    Double_t meanPhotons = 2000;
+    Double_t absTol = 1e-6, relTol = 1e-5, alpha = 0.01;
+    string reportFilename = "Validation_report.txt";
+
+    for(int i = 2; i < argc; i += 2)
+    {
+        if(i + 1 == argc)
+        {
+            cerr << "Missing value of option " << argv[i] << endl << usage << endl;
+            return 1;
+        }
+
+        if(strcmp(argv[i], "-n") == 0) nEvents = stoi(argv[i+1]);
+        else if(strcmp(argv[i], "-s") == 0) seed = stoul(argv[i+1]);
+        else if(strcmp(argv[i], "--photons") == 0) meanPhotons = stod(argv[i+1]);
+        else if(strcmp(argv[i], "--abs-tol") == 0) absTol = stod(argv[i+1]);
+        else if(strcmp(argv[i], "--rel-tol") == 0) relTol = stod(argv[i+1]);
+        else if(strcmp(argv[i], "--alpha") == 0) alpha = stod(argv[i+1]);
+        else if(strcmp(argv[i], "-o") == 0) reportFilename = argv[i+1];
+        else
+        {
+            cerr << "Unknown option " << argv[i] << endl << usage << endl;
+            return 1;
+        }
+    }
+
+    TH1::AddDirectory(false);
+
+    // Reference and engine with the same seed, plus the engine with another one
+    BarLYSO *reference = CreateBar(sipmFilename, true, seed);
+    BarLYSO *engine = CreateBar(sipmFilename, false, seed);
+    BarLYSO *engineIndep = CreateBar(sipmFilename, false, seed + 1000);
+
+    FeatureSettings settings;
+    SideFeatures features;
+    features.Resize(reference->GetChannels());
+    Estimators estRef, estEngine;
+
+    // Check 1: samples
+    TRandom3 randInput(seed);
+    Long64_t nChannels = 0, nBadChannels = 0;
+    Double_t maxDeviation = 0;
+    for(Int_t event = 0; event < nEvents; event++)
+    {
+        SyntheticEvent ev = GenerateEvent(randInput, meanPhotons, reference->GetChannels());
+        Synthesize(reference, event, ev);
+        Synthesize(engine, event, ev);
+        Synthesize(engineIndep, event, ev);
+
+        for(Int_t side = 0; side < 2; side++)
+        {
+            const auto &ref = (side == 0) ? reference->GetFront() : reference->GetBack();
+            const auto &eng = (side == 0) ? engine->GetFront() : engine->GetBack();
+            for(Int_t ch = 0; ch < reference->GetChannels(); ch++)
+            {
+                Bool_t isBad = false;
+                for(Int_t bin = 0; bin < reference->GetSamplings(); bin++)
+                {
+                    Double_t deviation = TMath::Abs(eng[ch][bin] - ref[ch][bin]);
+                    maxDeviation = max(maxDeviation, deviation);
+                    if(deviation > absTol + relTol * TMath::Abs(ref[ch][bin]))
+                        isBad = true;
+                }
+                nChannels++;
+                if(isBad) nBadChannels++;
+            }
+        }
+
+        // Check 2 uses the independent engine run
+        CollectEstimators(reference, ev, settings, features, estRef);
+        CollectEstimators(engineIndep, ev, settings, features, estEngine);
+
+        reference->ClearContainers();
+        engine->ClearContainers();
+        engineIndep->ClearContainers();
+    }
+    Bool_t isSamplesOk = (nBadChannels == 0);
+
+    // Check 2: distributions of the estimators
+    ofstream report(reportFilename);
+    report << "bartender_validate: " << sipmFilename << ", " << nEvents << " events, seed " << seed << ", " << meanPhotons << " photons per side on average\n\n";
+    report << "Samples: " << nBadChannels << "/" << nChannels << " channels out of tolerance (abs " << absTol << ", rel " << relTol << "), max deviation " << maxDeviation << " V -> " << (isSamplesOk ? "PASS" : "FAIL") << "\n\n";
+    report << "Distributions (alpha = " << alpha << "):\n";
+
+    Bool_t isDistributionsOk = true;
+    const vector<pair<string, pair<vector<Double_t>*, vector<Double_t>*>>> estimators = {
+        {"Charge", {&estRef.fCharge, &estEngine.fCharge}},
+        {"Amplitude", {&estRef.fAmplitude, &estEngine.fAmplitude}},
+        {"CFTime", {&estRef.fCFTime, &estEngine.fCFTime}}};
+    for(const auto &estimator : estimators)
+    {
+        vector<Double_t> &a = *estimator.second.first;
+        vector<Double_t> &b = *estimator.second.second;
+        if(a.empty() || b.empty())
+            continue;
+        sort(a.begin(), a.end());
+        sort(b.begin(), b.end());
+
+        Double_t pKS = TMath::KolmogorovTest(a.size(), a.data(), b.size(), b.data(), "");
+
+        Double_t lo = min(a.front(), b.front());
+        Double_t hi = max(a.back(), b.back());
+        if(hi <= lo) hi = lo + 1;
+        TH1D hRef("hRef", "", 50, lo, hi + 1e-6 * (hi - lo));
+        TH1D hEngine("hEngine", "", 50, lo, hi + 1e-6 * (hi - lo));
+        for(Double_t x : a) hRef.Fill(x);
+        for(Double_t x : b) hEngine.Fill(x);
+        Double_t pChi2 = hRef.Chi2Test(&hEngine, "UU");
+
+        Bool_t isOk = (pKS > alpha && pChi2 > alpha);
+        isDistributionsOk = isDistributionsOk && isOk;
+        report << "  " << estimator.first << ": mean " << TMath::Mean(a.size(), a.data()) << " vs " << TMath::Mean(b.size(), b.data())
+               << ", p(KS) = " << pKS << ", p(chi2) = " << pChi2 << " -> " << (isOk ? "PASS" : "FAIL") << "\n";
+    }
+    report.close();
+
+    cout << "Validation " << ((isSamplesOk && isDistributionsOk) ? "PASSED" : "FAILED") << ", report written to " << reportFilename << endl;
+
+    delete reference;
+    delete engine;
+    delete engineIndep;
+
+    return (isSamplesOk && isDistributionsOk) ? 0 : 1;
+}